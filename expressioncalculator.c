@@ -1,13 +1,29 @@
+#define _GNU_SOURCE // getline, sysconf(_SC_NPROCESSORS_ONLN)
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
 
-#define MAX_EXPR 4096
 #define MAX_TOKENS 4096
-#define MAX_TOKEN_LEN 64
+#define MAX_VARS   64
 
 // -------------------- Simple stack for operators (chars) --------------------
 typedef struct {
@@ -25,32 +41,26 @@ int  cs_push(CharStack *s, char c) {
 }
 char cs_pop(CharStack *s) { return s->data[s->top--]; }
 
-// -------------------- Simple stack for numbers (long long) --------------------
-typedef struct {
-    long long data[MAX_TOKENS];
-    int top;
-} NumStack;
-
-void ns_init(NumStack *s) { s->top = -1; }
-int  ns_empty(NumStack *s) { return s->top < 0; }
-int  ns_push(NumStack *s, long long v) {
-    if (s->top + 1 >= MAX_TOKENS) return 0;
-    s->data[++s->top] = v;
-    return 1;
-}
-long long ns_pop(NumStack *s) { return s->data[s->top--]; }
-
 // -------------------- Operator utilities --------------------
+// Operators are single characters inside the calculator. Two-character
+// operators get letter codes, like 'u' for unary minus, which cannot clash
+// because the lexer reads letters as variable names first:
+//   'l' <=   'g' >=   'e' ==   'n' !=   '&' &&   '|' ||
 int is_operator(char c) {
-    return c=='+' || c=='-' || c=='*' || c=='/' || c=='%' || c=='^' || c=='u'; // 'u' = unary minus
+    return c=='+' || c=='-' || c=='*' || c=='/' || c=='%' || c=='^' || c=='u' // 'u' = unary minus
+        || c=='<' || c=='>' || c=='l' || c=='g' || c=='e' || c=='n' || c=='&' || c=='|';
 }
 
 int precedence(char op) {
     switch (op) {
-        case 'u': return 4; // unary minus: highest
-        case '^': return 3;
-        case '*': case '/': case '%': return 2;
-        case '+': case '-': return 1;
+        case 'u': return 8; // unary minus: highest
+        case '^': return 7;
+        case '*': case '/': case '%': return 6;
+        case '+': case '-': return 5;
+        case '<': case '>': case 'l': case 'g': return 4;
+        case 'e': case 'n': return 3;
+        case '&': return 2;
+        case '|': return 1;
         default: return 0;
     }
 }
@@ -59,40 +69,412 @@ int is_right_assoc(char op) {
     return (op == '^' || op == 'u'); // right associative
 }
 
-// -------------------- Integer power (handles non-negative exponent) --------------------
+// Length of the operator starting at s (0 if there is none); its code goes to *op.
+int scan_operator(const char *s, char *op) {
+    static const char pairs[] = "<=l>=g==e!=n&&&|||";
+    for (const char *p = pairs; *p; p += 3)
+        if (s[0] == p[0] && s[1] == p[1]) { *op = p[2]; return 2; }
+    if (!s[0] || !strchr("+-*/%^<>", s[0])) return 0;
+    *op = s[0];
+    return 1;
+}
+
+// How an operator is written; unary minus shows as '~'.
+const char *operator_text(char op) {
+    switch (op) {
+        case 'u': return "~";
+        case 'l': return "<=";
+        case 'g': return ">=";
+        case 'e': return "==";
+        case 'n': return "!=";
+        case '&': return "&&";
+        case '|': return "||";
+        case '+': return "+"; case '-': return "-"; case '*': return "*";
+        case '/': return "/"; case '%': return "%"; case '^': return "^";
+        case '<': return "<"; case '>': return ">";
+        default: return "?";
+    }
+}
+
+int is_comparison(char op) {
+    return op == '<' || op == '>' || op == 'l' || op == 'g' || op == 'e' || op == 'n';
+}
+
+// Whether comparison op holds for operands that compare as cmp: -1, 0 or 1,
+// or 2 when they are unordered (a NaN), where only != holds. Comparisons and
+// && / || give 1 or 0, and && / || evaluate both operands.
+int comparison_holds(char op, int cmp) {
+    switch (op) {
+        case '<': return cmp == -1;
+        case '>': return cmp == 1;
+        case 'l': return cmp == -1 || cmp == 0;
+        case 'g': return cmp == 1 || cmp == 0;
+        case 'e': return cmp == 0;
+        default:  return cmp != 0; // 'n'
+    }
+}
+
+// -------------------- Power engine for '^' --------------------
+// Overflow is rejected up front from a per-base maximum-exponent table, so the
+// multiplications below never need their own overflow checks.
+#define POW_TABLE_SIZE 65537          // bases 0..2^16 are tabulated
+#define POW_CBRT_MAX   2097151LL      // largest b with b^3 <= LLONG_MAX
+#define POW_SQRT_MAX   3037000499LL   // largest b with b^2 <= LLONG_MAX
+#define POW_CHAIN_MAX  39             // 3^39 is the largest non-trivial power that fits
+
+static unsigned char pow_max_exp_table[POW_TABLE_SIZE];
+static int pow_table_ready = 0;
+
+void pow_table_init(void) {
+    if (pow_table_ready) return;
+    for (long long b = 2; b < POW_TABLE_SIZE; ++b) {
+        long long v = 1; int e = 0;
+        while (v <= LLONG_MAX / b) { v *= b; e++; }
+        pow_max_exp_table[b] = (unsigned char)e;
+    }
+    pow_table_ready = 1;
+}
+
+// Largest e such that mag^e <= LLONG_MAX (mag >= 2), in O(1).
+static long long pow_max_exp(unsigned long long mag) {
+    if (mag < POW_TABLE_SIZE) return pow_max_exp_table[mag];
+    if (mag <= POW_CBRT_MAX) return 3;
+    if (mag <= POW_SQRT_MAX) return 2;
+    return 1;
+}
+
+// Optimal addition chains for exponents 0..39: each pair of digits "ij" adds
+// the i-th and j-th earlier chain elements (element 0 is the base itself).
+static const char *pow_chain[POW_CHAIN_MAX + 1] = {
+    "", "", "00", "0001", "0011",
+    "001102", "001112", "00111203", "001122", "00112203",
+    "00112213", "0011221304", "00112223", "0011222304", "0011222314",
+    "0011023334", "00112233", "0011223304", "0011223314", "001122331405",
+    "0011223324", "001122332405", "001122332415", "001102234435", "0011223334",
+    "001122333405", "001122333415", "001122034445", "001122333425", "00112233342506",
+    "001122134445", "00112213444506", "0011223344", "001122334405", "001122334415",
+    "00112233441506", "001122334425", "00112233442506", "00112233442516", "00112223045556",
+};
+
+// Caller guarantees base^exp fits, so plain multiplication is safe here.
+static long long pow_by_chain(long long base, int exp) {
+    long long v[8];
+    const char *c = pow_chain[exp];
+    int n = 0;
+    v[0] = base;
+    for (; c[0]; c += 2) { v[n + 1] = v[c[0] - '0'] * v[c[1] - '0']; n++; }
+    return v[n];
+}
+
 int safe_pow_ll(long long base, long long exp, long long *out) {
     if (exp < 0) return 0; // not supporting negative exponents in integer arithmetic
-    long long result = 1;
-    while (exp) {
-        if (exp & 1) {
-            // Basic overflow check (conservative)
-            if (base != 0 && llabs(result) > LLONG_MAX / llabs(base)) return 0;
-            result *= base;
+    if (!pow_table_ready) pow_table_init();
+
+    if (exp == 0) { *out = 1; return 1; }
+    if (base == 0 || base == 1) { *out = base; return 1; }
+    if (base == -1) { *out = (exp & 1) ? -1 : 1; return 1; }
+
+    unsigned long long mag = base < 0 ? 0ULL - (unsigned long long)base : (unsigned long long)base;
+    int neg = base < 0 && (exp & 1);
+
+    // Powers of two: a single shift
+    if ((mag & (mag - 1)) == 0) {
+        int k = __builtin_ctzll(mag);
+        if (exp > 63 / k) return 0;
+        long long bits = k * exp;
+        if (bits == 63) {
+            if (!neg) return 0;
+            *out = LLONG_MIN;
+            return 1;
+        }
+        *out = neg ? -(1LL << bits) : (1LL << bits);
+        return 1;
+    }
+
+    if (exp > pow_max_exp(mag)) return 0;
+    *out = pow_by_chain(base, (int)exp); // exp <= POW_CHAIN_MAX here since mag >= 3
+    return 1;
+}
+
+// -------------------- Division by invariant divisors --------------------
+// Divisors known before evaluation (literals) are turned into a multiply-shift
+// pair once (Hacker's Delight, ch. 10), so every later '/' or '%' by them runs
+// without a hardware divide. Results truncate toward zero exactly like C.
+enum { DIV_HW, DIV_ONE, DIV_POW2, DIV_MAGIC };
+
+typedef struct {
+    long long d;
+    long long magic;
+    int shift;
+    int kind;
+} DivMagic;
+
+void divmagic_init(DivMagic *m, long long d) {
+    m->d = d; m->magic = 0; m->shift = 0;
+    if (d == 0 || d == -1) { m->kind = DIV_HW; return; } // leave errors/overflow to the plain path
+    if (d == 1) { m->kind = DIV_ONE; return; }
+
+    unsigned long long ad = d < 0 ? 0ULL - (unsigned long long)d : (unsigned long long)d;
+    if ((ad & (ad - 1)) == 0) {
+        m->kind = DIV_POW2;
+        m->shift = __builtin_ctzll(ad);
+        return;
+    }
+
+    const unsigned long long two63 = 1ULL << 63;
+    unsigned long long t = two63 + ((unsigned long long)d >> 63);
+    unsigned long long anc = t - 1 - t % ad;
+    unsigned long long q1 = two63 / anc, r1 = two63 - q1 * anc;
+    unsigned long long q2 = two63 / ad,  r2 = two63 - q2 * ad;
+    unsigned long long delta;
+    int p = 63;
+    do {
+        p++;
+        q1 *= 2; r1 *= 2; if (r1 >= anc) { q1++; r1 -= anc; }
+        q2 *= 2; r2 *= 2; if (r2 >= ad)  { q2++; r2 -= ad; }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    m->kind = DIV_MAGIC;
+    m->magic = (long long)(q2 + 1);
+    if (d < 0) m->magic = (long long)(0ULL - (unsigned long long)m->magic);
+    m->shift = p - 64;
+}
+
+static inline long long divmagic_div(const DivMagic *m, long long n) {
+    switch (m->kind) {
+        case DIV_ONE: return n;
+        case DIV_POW2: {
+            unsigned long long bias = (unsigned long long)(n >> 63) & ((1ULL << m->shift) - 1);
+            long long q = (long long)((unsigned long long)n + bias) >> m->shift;
+            return m->d < 0 ? -q : q;
         }
-        exp >>= 1;
-        if (exp) {
-            if (llabs(base) > 0 && llabs(base) > LLONG_MAX / llabs(base)) return 0;
-            base *= base;
+        case DIV_MAGIC: {
+            long long q = (long long)(((__int128)m->magic * n) >> 64);
+            if (m->d > 0 && m->magic < 0) q = (long long)((unsigned long long)q + (unsigned long long)n);
+            if (m->d < 0 && m->magic > 0) q = (long long)((unsigned long long)q - (unsigned long long)n);
+            q >>= m->shift;
+            return q + (long long)((unsigned long long)q >> 63);
         }
+        default: return n / m->d;
+    }
+}
+
+static inline long long divmagic_mod(const DivMagic *m, long long n) {
+    long long q = divmagic_div(m, n);
+    return (long long)((unsigned long long)n - (unsigned long long)q * (unsigned long long)m->d);
+}
+
+// -------------------- CPU feature dispatch --------------------
+// SIMD code is compiled for several instruction sets in one binary and the
+// best level the CPU supports is picked once at startup (--simd forces one).
+enum { SIMD_SCALAR, SIMD_SSE42, SIMD_AVX2, SIMD_AVX512, SIMD_LEVELS };
+
+static const char *simd_names[SIMD_LEVELS] = { "scalar", "sse4.2", "avx2", "avx512" };
+static int simd_level = SIMD_SCALAR;
+
+int simd_supported(int level) {
+#if SIMD_X86
+    __builtin_cpu_init();
+    switch (level) {
+        case SIMD_SSE42: return __builtin_cpu_supports("sse4.2");
+        case SIMD_AVX2: return __builtin_cpu_supports("avx2");
+        case SIMD_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+    }
+#endif
+    return level == SIMD_SCALAR;
+}
+
+// Length of the run of ASCII digits at s (s is NUL-terminated). The vector
+// versions use aligned loads only, so they never read across a page boundary.
+static size_t scan_digits_scalar(const char *s) {
+    const char *p = s;
+    while (*p >= '0' && *p <= '9') p++;
+    return (size_t)(p - s);
+}
+
+#if SIMD_X86
+__attribute__((target("sse4.2")))
+static size_t scan_digits_sse42(const char *s) {
+    const char *p = s;
+    for (; (uintptr_t)p & 15; ++p) if (*p < '0' || *p > '9') return (size_t)(p - s);
+    const __m128i range = _mm_setr_epi8('0', '9', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (;; p += 16) {
+        // first byte outside '0'..'9', counting the terminating NUL
+        int idx = _mm_cmpistri(range, _mm_load_si128((const __m128i *)p),
+                               _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY);
+        if (idx < 16) return (size_t)(p + idx - s);
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t scan_digits_avx2(const char *s) {
+    const char *p = s;
+    for (; (uintptr_t)p & 31; ++p) if (*p < '0' || *p > '9') return (size_t)(p - s);
+    const __m256i zero = _mm256_set1_epi8('0'), nine = _mm256_set1_epi8(9);
+    for (;; p += 32) {
+        __m256i d = _mm256_sub_epi8(_mm256_load_si256((const __m256i *)p), zero);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_max_epu8(d, nine), nine);
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(is_digit);
+        if (mask) return (size_t)(p + __builtin_ctz(mask) - s);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_digits_avx512(const char *s) {
+    const char *p = s;
+    for (; (uintptr_t)p & 63; ++p) if (*p < '0' || *p > '9') return (size_t)(p - s);
+    const __m512i zero = _mm512_set1_epi8('0'), nine = _mm512_set1_epi8(9);
+    for (;; p += 64) {
+        __m512i d = _mm512_sub_epi8(_mm512_load_si512((const void *)p), zero);
+        __mmask64 other = _mm512_cmpgt_epu8_mask(d, nine);
+        if (other) return (size_t)(p + __builtin_ctzll(other) - s);
+    }
+}
+#endif
+
+static size_t (*scan_digits)(const char *s) = scan_digits_scalar;
+
+// Bit i set when p[i] (i < 64) is delim or '\n'. p must have 64 readable bytes.
+static uint64_t delim_mask_scalar(const char *p, char delim) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; ++i) m |= (uint64_t)(p[i] == delim || p[i] == '\n') << i;
+    return m;
+}
+
+#if SIMD_X86
+__attribute__((target("sse4.2")))
+static uint64_t delim_mask_sse42(const char *p, char delim) {
+    const __m128i d = _mm_set1_epi8(delim), nl = _mm_set1_epi8('\n');
+    uint64_t m = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        m |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, d), _mm_cmpeq_epi8(v, nl))) << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+static uint64_t delim_mask_avx2(const char *p, char delim) {
+    const __m256i d = _mm256_set1_epi8(delim), nl = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256((const __m256i *)p), hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    uint32_t mlo = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(lo, d), _mm256_cmpeq_epi8(lo, nl)));
+    uint32_t mhi = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(hi, d), _mm256_cmpeq_epi8(hi, nl)));
+    return (uint64_t)mhi << 32 | mlo;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t delim_mask_avx512(const char *p, char delim) {
+    __m512i v = _mm512_loadu_si512((const void *)p);
+    return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(delim)) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+}
+#endif
+
+static uint64_t (*delim_mask)(const char *p, char delim) = delim_mask_scalar;
+
+// 64-bit hash of n bytes, taken 8 bytes at a time, for the result cache.
+// The SSE4.2 version runs two CRC32C streams with different seeds through
+// the crc32 instruction; the wider levels use it too, as keys are short.
+static uint64_t text_hash_scalar(const char *s, size_t n) {
+    uint64_t h = n * 0x9E3779B97F4A7C15ULL, w;
+    for (; n >= 8; s += 8, n -= 8) {
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    w = 0;
+    memcpy(&w, s, n);
+    h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    return h ^ h >> 32;
+}
+
+#if SIMD_X86
+__attribute__((target("sse4.2")))
+static uint64_t text_hash_sse42(const char *s, size_t n) {
+    uint64_t lo = n, hi = ~(uint64_t)n, w;
+    for (; n >= 8; s += 8, n -= 8) {
+        memcpy(&w, s, 8);
+        lo = _mm_crc32_u64(lo, w);
+        hi = _mm_crc32_u64(hi, w ^ 0x9E3779B97F4A7C15ULL);
     }
-    *out = result;
+    w = 0;
+    memcpy(&w, s, n);
+    lo = _mm_crc32_u64(lo, w);
+    hi = _mm_crc32_u64(hi, w ^ 0x9E3779B97F4A7C15ULL);
+    return hi << 32 | lo;
+}
+#endif
+
+static uint64_t (*text_hash)(const char *s, size_t n) = text_hash_scalar;
+
+// Selects the SIMD level: the best supported one, or forced (>= 0). 0 if the
+// forced level is not supported by this CPU.
+int simd_init(int forced) {
+    int level = forced;
+    if (level < 0)
+        for (level = SIMD_LEVELS - 1; level > SIMD_SCALAR && !simd_supported(level); --level) {}
+    if (!simd_supported(level)) return 0;
+    simd_level = level;
+#if SIMD_X86
+    static size_t (*const scanners[SIMD_LEVELS])(const char *) = {
+        scan_digits_scalar, scan_digits_sse42, scan_digits_avx2, scan_digits_avx512
+    };
+    static uint64_t (*const maskers[SIMD_LEVELS])(const char *, char) = {
+        delim_mask_scalar, delim_mask_sse42, delim_mask_avx2, delim_mask_avx512
+    };
+    scan_digits = scanners[level];
+    delim_mask = maskers[level];
+    text_hash = level >= SIMD_SSE42 ? text_hash_sse42 : text_hash_scalar;
+#endif
     return 1;
 }
 
 // -------------------- Token helpers --------------------
+// Numbers and variable names are kept as spans into the input line, so
+// literals of any length survive until the evaluator of the active mode parses them.
+typedef struct {
+    char op;          // operator character, or 0 for a number or variable
+    const char *text; // number digits or variable name (not NUL-terminated)
+    int len;
+    int decimal;      // LIT_FRACTION / LIT_EXPONENT flags, e.g. 12.50 or 1e-3
+    int var;          // 1 for a variable
+} Token;
+
+enum { LIT_FRACTION = 1, LIT_EXPONENT = 2 };
+
 typedef struct {
-    char items[MAX_TOKENS][MAX_TOKEN_LEN];
+    Token items[MAX_TOKENS];
     int count;
 } TokenList;
 
 void tokens_init(TokenList *tl) { tl->count = 0; }
-int  tokens_add(TokenList *tl, const char *s) {
+int  tokens_add_op(TokenList *tl, char op) {
+    if (tl->count >= MAX_TOKENS) return 0;
+    tl->items[tl->count].op = op;
+    tl->items[tl->count].text = NULL;
+    tl->items[tl->count].len = 0;
+    tl->items[tl->count].decimal = 0;
+    tl->items[tl->count].var = 0;
+    tl->count++;
+    return 1;
+}
+int  tokens_add_num(TokenList *tl, const char *text, int len, int decimal) {
     if (tl->count >= MAX_TOKENS) return 0;
-    strncpy(tl->items[tl->count], s, MAX_TOKEN_LEN-1);
-    tl->items[tl->count][MAX_TOKEN_LEN-1] = '\0';
+    tl->items[tl->count].op = 0;
+    tl->items[tl->count].text = text;
+    tl->items[tl->count].len = len;
+    tl->items[tl->count].decimal = decimal;
+    tl->items[tl->count].var = 0;
     tl->count++;
     return 1;
 }
+int  tokens_add_var(TokenList *tl, const char *text, int len) {
+    if (!tokens_add_num(tl, text, len, 0)) return 0;
+    tl->items[tl->count - 1].var = 1;
+    return 1;
+}
 
 // -------------------- Infix to Postfix (Shunting-Yard) --------------------
 int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
@@ -105,19 +487,36 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
     while (expr[i]) {
         if (isspace((unsigned char)expr[i])) { i++; continue; }
 
-        // Number (supports multi-digit and leading spaces)
+        // Number (supports multi-digit, leading spaces, a decimal fraction and an exponent)
         if (isdigit((unsigned char)expr[i])) {
-            char buf[MAX_TOKEN_LEN]; int bi = 0;
-            while (isdigit((unsigned char)expr[i])) {
-                if (bi+1 >= MAX_TOKEN_LEN) { strcpy(err_msg,"Number token too long"); return 0; }
-                buf[bi++] = expr[i++];
+            int start = i, decimal = 0;
+            i += (int)scan_digits(expr + i);
+            if (expr[i] == '.' && isdigit((unsigned char)expr[i+1])) {
+                decimal |= LIT_FRACTION;
+                i++;
+                i += (int)scan_digits(expr + i);
             }
-            buf[bi] = '\0';
-            if (!tokens_add(out_postfix, buf)) { strcpy(err_msg,"Too many tokens"); return 0; }
+            if ((expr[i] == 'e' || expr[i] == 'E')
+                && (isdigit((unsigned char)expr[i+1])
+                    || ((expr[i+1] == '+' || expr[i+1] == '-') && isdigit((unsigned char)expr[i+2])))) {
+                decimal |= LIT_EXPONENT;
+                i += 2;
+                i += (int)scan_digits(expr + i);
+            }
+            if (!tokens_add_num(out_postfix, expr + start, i - start, decimal)) { strcpy(err_msg,"Too many tokens"); return 0; }
             expect_operand = 0; // next should be operator or ')'
             continue;
         }
 
+        // Variable: a letter or '_' followed by letters, digits or '_'
+        if (isalpha((unsigned char)expr[i]) || expr[i] == '_') {
+            int start = i;
+            while (isalnum((unsigned char)expr[i]) || expr[i] == '_') i++;
+            if (!tokens_add_var(out_postfix, expr + start, i - start)) { strcpy(err_msg,"Too many tokens"); return 0; }
+            expect_operand = 0;
+            continue;
+        }
+
         // Parentheses
         if (expr[i] == '(') {
             if (!cs_push(&ops, '(')) { strcpy(err_msg,"Operator stack overflow"); return 0; }
@@ -129,8 +528,7 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
             while (!cs_empty(&ops)) {
                 char top = cs_pop(&ops);
                 if (top == '(') { matched = 1; break; }
-                char op_str[2] = {top, '\0'};
-                if (!tokens_add(out_postfix, op_str)) { strcpy(err_msg,"Too many tokens"); return 0; }
+                if (!tokens_add_op(out_postfix, top)) { strcpy(err_msg,"Too many tokens"); return 0; }
             }
             if (!matched) { strcpy(err_msg,"Mismatched parentheses"); return 0; }
             i++; expect_operand = 0;
@@ -138,8 +536,9 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
         }
 
         // Operators (including unary minus)
-        if (is_operator(expr[i])) {
-            char op = expr[i];
+        char op;
+        int op_len = scan_operator(expr + i, &op);
+        if (op_len) {
 
             // Determine unary minus
             if (op == '-' && expect_operand) {
@@ -155,12 +554,11 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
                 int ptop = precedence(top), popr = precedence(op);
                 if ( (ptop > popr) || (ptop == popr && !is_right_assoc(op)) ) {
                     top = cs_pop(&ops);
-                    char op_str[2] = {top, '\0'};
-                    if (!tokens_add(out_postfix, op_str)) { strcpy(err_msg,"Too many tokens"); return 0; }
+                    if (!tokens_add_op(out_postfix, top)) { strcpy(err_msg,"Too many tokens"); return 0; }
                 } else break;
             }
             if (!cs_push(&ops, op)) { strcpy(err_msg,"Operator stack overflow"); return 0; }
-            i++;
+            i += op_len;
             expect_operand = (op != 'u'); // after unary minus we still expect an operand; for binary op we expect operand next
             continue;
         }
@@ -174,8 +572,7 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
     while (!cs_empty(&ops)) {
         char top = cs_pop(&ops);
         if (top == '(' || top == ')') { strcpy(err_msg,"Mismatched parentheses"); return 0; }
-        char op_str[2] = {top, '\0'};
-        if (!tokens_add(out_postfix, op_str)) { strcpy(err_msg,"Too many tokens"); return 0; }
+        if (!tokens_add_op(out_postfix, top)) { strcpy(err_msg,"Too many tokens"); return 0; }
     }
 
     if (expect_operand) { strcpy(err_msg,"Expression ends unexpectedly"); return 0; }
@@ -183,20 +580,75 @@ int infix_to_postfix(const char *expr, TokenList *out_postfix, char *err_msg) {
     return 1;
 }
 
+// -------------------- Postfix evaluation engine --------------------
+// One evaluator shared by every numeric mode. A mode supplies three functions
+// for its value type and instantiates the engine with
+// DEFINE_ENGINE(prefix, Value, StackType):
+//   int prefix##_literal(const Token *t, Value *out, char *err_msg);
+//   int prefix##_negate(Value *v, char *err_msg);
+//   int prefix##_binary(char op, Value a, Value b, Value *out, char *err_msg);
+// Each instantiation gets its own stack type, prefix##_apply_op and
+// prefix##_evaluate_postfix with those functions called directly, so the
+// inner loop has no function pointers or value-type tags.
+#define DEFINE_ENGINE(prefix, Value, StackType)                                         \
+typedef struct {                                                                        \
+    Value data[MAX_TOKENS];                                                             \
+    int top;                                                                            \
+} StackType;                                                                            \
+                                                                                        \
+static inline int prefix##_apply_op(char op, StackType *stk, char *err_msg) {           \
+    if (op == 'u') {                                                                    \
+        if (stk->top < 0) { strcpy(err_msg,"Not enough operands for unary minus"); return 0; } \
+        return prefix##_negate(&stk->data[stk->top], err_msg);                          \
+    }                                                                                   \
+    if (stk->top < 1) { strcpy(err_msg,"Not enough operands for binary operator"); return 0; } \
+    Value b = stk->data[stk->top--];                                                    \
+    Value a = stk->data[stk->top];                                                      \
+    return prefix##_binary(op, a, b, &stk->data[stk->top], err_msg);                    \
+}                                                                                       \
+                                                                                        \
+int prefix##_evaluate_postfix(const TokenList *postfix, Value *result, char *err_msg) { \
+    StackType stk; stk.top = -1;                                                        \
+    for (int i = 0; i < postfix->count; ++i) {                                          \
+        const Token *t = &postfix->items[i];                                            \
+        if (t->op) {                                                                    \
+            if (!prefix##_apply_op(t->op, &stk, err_msg)) return 0;                     \
+            continue;                                                                   \
+        }                                                                               \
+        if (t->var) { strcpy(err_msg,"Variables need --batch"); return 0; }             \
+        if (stk.top + 1 >= MAX_TOKENS) { strcpy(err_msg,"Value stack overflow"); return 0; } \
+        if (!prefix##_literal(t, &stk.data[stk.top + 1], err_msg)) return 0;            \
+        stk.top++;                                                                      \
+    }                                                                                   \
+    if (stk.top != 0) { strcpy(err_msg,"Extra operands or insufficient operators"); return 0; } \
+    *result = stk.data[0];                                                              \
+    return 1;                                                                           \
+}
+
 // -------------------- Postfix evaluation --------------------
-int apply_op(char op, NumStack *stk, long long *err_val, char *err_msg) {
-    if (op == 'u') {
-        if (stk->top < 0) { strcpy(err_msg,"Not enough operands for unary minus"); return 0; }
-        long long a = ns_pop(stk);
-        if (!ns_push(stk, -a)) { strcpy(err_msg,"Value stack overflow"); return 0; }
-        return 1;
+static inline int int64_literal(const Token *t, long long *out, char *err_msg) {
+    if (t->decimal) { strcpy(err_msg,"Decimal literals need --fixed or --double"); return 0; }
+    errno = 0;
+    char *endptr = NULL;
+    long long val = strtoll(t->text, &endptr, 10);
+    if (errno != 0 || endptr != t->text + t->len) {
+        strcpy(err_msg,"Invalid number in postfix");
+        return 0;
     }
+    *out = val;
+    return 1;
+}
 
-    if (stk->top < 1) { strcpy(err_msg,"Not enough operands for binary operator"); return 0; }
-    long long b = ns_pop(stk);
-    long long a = ns_pop(stk);
+static inline int int64_negate(long long *v, char *err_msg) {
+    (void)err_msg;
+    *v = (long long)(0ULL - (unsigned long long)*v);
+    return 1;
+}
+
+static inline int int64_binary(char op, long long a, long long b, long long *out, char *err_msg) {
     long long r = 0;
 
+    if (is_comparison(op)) { *out = comparison_holds(op, (a > b) - (a < b)); return 1; }
     switch (op) {
         case '+': r = a + b; break;
         case '-': r = a - b; break;
@@ -210,93 +662,4556 @@ int apply_op(char op, NumStack *stk, long long *err_val, char *err_msg) {
         case '^':
             if (!safe_pow_ll(a, b, &r)) { strcpy(err_msg,"Invalid or overflow in exponentiation"); return 0; }
             break;
+        case '&': r = a && b; break;
+        case '|': r = a || b; break;
         default:
             strcpy(err_msg,"Unknown operator in evaluation");
             return 0;
     }
-    if (!ns_push(stk, r)) { strcpy(err_msg,"Value stack overflow"); return 0; }
-    (void)err_val;
+    *out = r;
     return 1;
 }
 
-int evaluate_postfix(const TokenList *postfix, long long *result, char *err_msg) {
-    NumStack stk; ns_init(&stk);
+DEFINE_ENGINE(int64, long long, NumStack)
+
+// -------------------- Compiled postfix program --------------------
+// Formulas for the batch evaluators are compiled once: numbers are parsed up
+// front and a literal divisor directly feeding '/' or '%' is fused into a
+// single instruction carrying its precomputed DivMagic. Variables are
+// numbered in order of first appearance.
+enum { INS_PUSH, INS_LOAD, INS_OP, INS_DIVC, INS_MODC };
+
+typedef struct {
+    int kind;
+    char op;          // INS_OP
+    long long value;  // INS_PUSH; variable index for INS_LOAD
+    DivMagic div;     // INS_DIVC / INS_MODC
+} Instr;
+
+typedef struct {
+    Instr code[MAX_TOKENS];
+    int count;
+    int nvars;
+    const char *var_name[MAX_VARS]; // spans into the formula text
+    int var_len[MAX_VARS];
+    int depth;                      // set by program_check
+} Program;
+
+static int program_var(Program *prog, const Token *t, char *err_msg) {
+    for (int v = 0; v < prog->nvars; ++v)
+        if (prog->var_len[v] == t->len && memcmp(prog->var_name[v], t->text, (size_t)t->len) == 0) return v;
+    if (prog->nvars >= MAX_VARS) { strcpy(err_msg,"Too many variables"); return -1; }
+    prog->var_name[prog->nvars] = t->text;
+    prog->var_len[prog->nvars] = t->len;
+    return prog->nvars++;
+}
+
+int compile_postfix(const TokenList *postfix, Program *prog, char *err_msg) {
+    prog->count = 0;
+    prog->nvars = 0;
+    prog->depth = 0;
 
     for (int i = 0; i < postfix->count; ++i) {
-        const char *t = postfix->items[i];
+        const Token *t = &postfix->items[i];
+        Instr *ins = &prog->code[prog->count];
 
-        // operator (single char token)
-        if (strlen(t) == 1 && is_operator(t[0])) {
-            if (!apply_op(t[0], &stk, result, err_msg)) return 0;
+        if (t->op) {
+            Instr *prev = prog->count > 0 ? ins - 1 : NULL;
+            if ((t->op == '/' || t->op == '%') && prev && prev->kind == INS_PUSH
+                && prev->value != 0 && prev->value != -1) { // 0 and -1 keep apply_op's checks
+                long long d = prev->value;
+                prev->kind = (t->op == '/') ? INS_DIVC : INS_MODC;
+                divmagic_init(&prev->div, d);
+                continue;
+            }
+            ins->kind = INS_OP;
+            ins->op = t->op;
+            ins->value = 0;
+            prog->count++;
+            continue;
+        }
+
+        if (t->var) {
+            int v = program_var(prog, t, err_msg);
+            if (v < 0) return 0;
+            ins->kind = INS_LOAD;
+            ins->value = v;
+            prog->count++;
             continue;
         }
 
         // number
-        errno = 0;
-        char *endptr = NULL;
-        long long val = strtoll(t, &endptr, 10);
-        if (errno != 0 || endptr == t || *endptr != '\0') {
-            strcpy(err_msg,"Invalid number in postfix");
+        if (!int64_literal(t, &ins->value, err_msg)) return 0;
+        ins->kind = INS_PUSH;
+        prog->count++;
+    }
+    return 1;
+}
+
+// Checks operand counts without running the program and records the stack
+// depth it needs, for evaluators that cannot stop halfway through.
+int program_check(Program *prog, char *err_msg) {
+    int depth = 0;
+    prog->depth = 0;
+    for (int i = 0; i < prog->count; ++i) {
+        const Instr *ins = &prog->code[i];
+        if (ins->kind == INS_PUSH || ins->kind == INS_LOAD) {
+            if (++depth > prog->depth) prog->depth = depth;
+        } else if (ins->kind == INS_DIVC || ins->kind == INS_MODC) {
+            if (depth < 1) { strcpy(err_msg,"Not enough operands for binary operator"); return 0; }
+        } else if (ins->op == 'u') {
+            if (depth < 1) { strcpy(err_msg,"Not enough operands for unary minus"); return 0; }
+        } else if (depth-- < 2) {
+            strcpy(err_msg,"Not enough operands for binary operator");
             return 0;
         }
-        if (!ns_push(&stk, val)) { strcpy(err_msg,"Value stack overflow"); return 0; }
     }
-
-    if (stk.top != 0) { strcpy(err_msg,"Extra operands or insufficient operators"); return 0; }
-    *result = ns_pop(&stk);
+    if (depth != 1) { strcpy(err_msg,"Extra operands or insufficient operators"); return 0; }
     return 1;
 }
 
-// -------------------- Utility: join postfix tokens to a printable string --------------------
-void print_postfix(const TokenList *postfix) {
-    for (int i = 0; i < postfix->count; ++i) {
-        // Print unary minus as '~' just for display clarity
-        if (strlen(postfix->items[i])==1 && postfix->items[i][0]=='u') putchar('~');
-        else fputs(postfix->items[i], stdout);
-        if (i + 1 < postfix->count) putchar(' ');
+// Parses, compiles and checks a formula for the batch evaluators.
+static int batch_compile(const char *formula, TokenList *postfix, Program *prog, char *err_msg) {
+    return infix_to_postfix(formula, postfix, err_msg) && compile_postfix(postfix, prog, err_msg)
+        && program_check(prog, err_msg);
+}
+
+// -------------------- Worker threads --------------------
+// parallel_for splits [0, count) into one contiguous range per thread; the
+// caller runs the first range itself. Workers are started on first use and
+// then sleep on a condition variable between calls, so a call costs a wakeup
+// rather than a thread creation (the NTT makes one call per stage). A call
+// made while another is running, such as one from inside a worker, runs
+// inline.
+static int num_threads = 1;
+
+typedef void (*RangeFn)(void *ctx, size_t begin, size_t end);
+
+typedef struct {
+    RangeFn fn;
+    void *ctx;
+    size_t begin, end;
+} RangeTask;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+    int workers, busy;
+    const RangeTask *task;
+    int ntask, next, pending;      // ranges of the current call: next unclaimed, not yet finished
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, NULL, 0, 0, 0 };
+
+// Claims and runs ranges of the current call until none are left; called
+// and returns with the lock held.
+static void pool_drain(void) {
+    while (pool.next < pool.ntask) {
+        const RangeTask *t = &pool.task[pool.next++];
+        pthread_mutex_unlock(&pool.lock);
+        t->fn(t->ctx, t->begin, t->end);
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0) pthread_cond_signal(&pool.done);
     }
-    putchar('\n');
 }
 
-// -------------------- Main: interactive single-line evaluator --------------------
-int main(void) {
-    char line[MAX_EXPR];
+static void *pool_worker_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.next >= pool.ntask) pthread_cond_wait(&pool.wake, &pool.lock);
+        pool_drain();
+    }
+    return NULL;
+}
 
-    printf("Expression Calculator (integers)\n");
-    printf("Supports: + - * / %% ^, parentheses, unary minus\n");
-    printf("Examples:\n");
-    printf("  -3 + 4*(2-1) ^ 3\n");
-    printf("  2*-5 + (7 - -(3))\n");
-    printf("Enter expression (or empty line to quit):\n\n");
+void parallel_for(size_t count, size_t min_per_thread, RangeFn fn, void *ctx) {
+    int nt = num_threads;
+    if (min_per_thread && (size_t)nt > count / min_per_thread) nt = (int)(count / min_per_thread);
+    if (nt <= 1) { fn(ctx, 0, count); return; }
 
-    while (1) {
-        printf("> ");
-        if (!fgets(line, sizeof(line), stdin)) break;
+    pthread_mutex_lock(&pool.lock);
+    if (pool.busy) { pthread_mutex_unlock(&pool.lock); fn(ctx, 0, count); return; }
+    pool.busy = 1;
+    for (pthread_t tid; pool.workers < nt - 1 && pthread_create(&tid, NULL, pool_worker_main, NULL) == 0; pool.workers++)
+        pthread_detach(tid); // if some could not start, the caller runs their ranges
 
-        // Trim leading spaces; quit on empty
-        int allspace = 1;
-        for (char *p=line; *p; ++p) { if (!isspace((unsigned char)*p)) { allspace = 0; break; } }
-        if (allspace) break;
+    RangeTask task[nt];
+    for (int i = 0; i < nt; ++i) {
+        task[i].fn = fn; task[i].ctx = ctx;
+        task[i].begin = count * (size_t)i / (size_t)nt;
+        task[i].end = count * (size_t)(i + 1) / (size_t)nt;
+    }
+    pool.task = task;
+    pool.ntask = nt;
+    pool.next = 1;
+    pool.pending = nt - 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
 
-        TokenList postfix;
-        char err[128] = {0};
+    fn(ctx, task[0].begin, task[0].end);
 
-        if (!infix_to_postfix(line, &postfix, err)) {
-            printf("Error (infix->postfix): %s\n", err);
-            continue;
+    pthread_mutex_lock(&pool.lock);
+    pool_drain();
+    while (pool.pending) pthread_cond_wait(&pool.done, &pool.lock);
+    pool.busy = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// -------------------- Columnar evaluation --------------------
+// One compiled program applied to every row of a table, a block of COL_BLOCK
+// rows at a time. Each instruction is a single loop over the block, written
+// branch-free so the compiler emits SIMD code for it, and stack slots are
+// block-sized registers that stay in L1. Rows that divide by zero or overflow
+// are marked in per-kind error bitmaps instead of stopping the batch.
+// Blocks are grouped into morsels that worker threads claim from an atomic
+// counter; morsels cover disjoint rows and bitmap words, so workers write
+// the preallocated outputs without locks.
+#define COL_BLOCK  1024              // rows per block (8 KB per register); a multiple of 64
+#define COL_MORSEL (16 * COL_BLOCK)  // rows a worker claims at a time
+
+enum { COL_ERR_DIV_ZERO, COL_ERR_MOD_ZERO, COL_ERR_OVERFLOW, COL_ERR_POW, COL_ERR_KINDS };
+
+#define COL_SKIPPED COL_ERR_KINDS  // flag bit of rows left out of aggregates
+
+static const char *col_err_names[COL_ERR_KINDS] = {
+    "Division by zero", "Modulo by zero", "Integer overflow", "Invalid or overflow in exponentiation"
+};
+
+// Running sum, min, max and count of results. 2^62 rows of int64s cannot
+// overflow the 128-bit sum.
+typedef struct {
+    __int128 sum;
+    long long min, max;
+    size_t count, errors;          // rows folded in, and rows left out for an error
+} ColAggregate;
+
+typedef struct {
+    size_t rows;
+    const long long **cols;        // one input column per program variable
+    long long *out;
+    uint64_t *err[COL_ERR_KINDS];  // per-row bitmaps of (rows + 63) / 64 words
+    uint64_t *selected;            // rows kept by --where (shared by a set's batches); NULL if none
+    ColAggregate *agg;             // when set, results are folded into it instead of stored
+    const uint64_t *skip;          // rows agg leaves out (null or invalid inputs), or NULL
+} ColumnBatch;
+
+typedef struct {
+    long long *buf;                // prog->depth registers of COL_BLOCK values
+    const long long **slot;        // what each stack slot currently holds
+    unsigned char flags[COL_BLOCK];
+    ColAggregate agg;              // this worker's share of b->agg
+} ColScratch;
+
+// Kernel bodies: r may be the same array as a (never partially overlapping),
+// so ivdep is safe. f collects 1 << COL_ERR_* per row. They are compiled once
+// per SIMD level by COL_KERNEL_SET below.
+#define COL_BODY static inline __attribute__((always_inline))
+
+COL_BODY void col_add_body(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        long long s = (long long)((unsigned long long)a[i] + (unsigned long long)b[i]);
+        f[i] |= (unsigned char)((((a[i] ^ s) & (b[i] ^ s)) < 0) << COL_ERR_OVERFLOW);
+        r[i] = s;
+    }
+}
+
+COL_BODY void col_sub_body(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        long long s = (long long)((unsigned long long)a[i] - (unsigned long long)b[i]);
+        f[i] |= (unsigned char)((((a[i] ^ b[i]) & (a[i] ^ s)) < 0) << COL_ERR_OVERFLOW);
+        r[i] = s;
+    }
+}
+
+COL_BODY void col_mul_body(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        long long p;
+        f[i] |= (unsigned char)(__builtin_mul_overflow(a[i], b[i], &p) << COL_ERR_OVERFLOW);
+        r[i] = p;
+    }
+}
+
+COL_BODY void col_div_body(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        int zero = b[i] == 0, ovf = a[i] == LLONG_MIN && b[i] == -1;
+        f[i] |= (unsigned char)((zero << COL_ERR_DIV_ZERO) | (ovf << COL_ERR_OVERFLOW));
+        r[i] = a[i] / (zero | ovf ? 1 : b[i]);
+    }
+}
+
+COL_BODY void col_mod_body(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        int zero = b[i] == 0;
+        f[i] |= (unsigned char)(zero << COL_ERR_MOD_ZERO);
+        r[i] = a[i] % (zero || b[i] == -1 ? 1 : b[i]);
+    }
+}
+
+COL_BODY void col_neg_body(long long *r, const long long *a, unsigned char *f, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) {
+        f[i] |= (unsigned char)((a[i] == LLONG_MIN) << COL_ERR_OVERFLOW);
+        r[i] = (long long)(0ULL - (unsigned long long)a[i]);
+    }
+}
+
+// Comparisons and && / || cannot fail; > and >= are < and <= with the
+// operands swapped, so r may also be b.
+#define COL_COMPARE_BODY(name, expr)                                                                    \
+COL_BODY void col_##name##_body(long long *r, const long long *a, const long long *b, size_t n) {        \
+    _Pragma("GCC ivdep")                                                                                 \
+    for (size_t i = 0; i < n; ++i) r[i] = (expr);                                                        \
+}
+
+COL_COMPARE_BODY(lt, a[i] < b[i])
+COL_COMPARE_BODY(le, a[i] <= b[i])
+COL_COMPARE_BODY(eq, a[i] == b[i])
+COL_COMPARE_BODY(ne, a[i] != b[i])
+COL_COMPARE_BODY(land, (a[i] != 0) & (b[i] != 0))
+COL_COMPARE_BODY(lor, (a[i] | b[i]) != 0)
+
+// Folds the n <= COL_BLOCK values of v whose flags are clear into a. The sum
+// adds the low and high 32-bit halves separately, which cannot overflow
+// within a block, so the loop vectorizes with no carries.
+COL_BODY void col_fold_body(ColAggregate *a, const long long *v, const unsigned char *f, size_t n) {
+    unsigned long long lo = 0, count = 0, errors = 0;
+    long long hi = 0, mn = LLONG_MAX, mx = LLONG_MIN;
+    for (size_t i = 0; i < n; ++i) {
+        long long keep = -(long long)(f[i] == 0); // all ones or zero
+        long long x = v[i] & keep;
+        long long low = x | (LLONG_MAX & ~keep), high = x | (LLONG_MIN & ~keep);
+        lo += (unsigned long long)x & 0xFFFFFFFFULL;
+        hi += x >> 32;
+        mn = low < mn ? low : mn;
+        mx = high > mx ? high : mx;
+        count += (unsigned long long)(keep & 1);
+        errors += (unsigned long long)(f[i] != 0 && f[i] < 1 << COL_SKIPPED); // an error, and not skipped
+    }
+    a->sum += (__int128)hi * 4294967296 + (__int128)lo;
+    if (mn < a->min) a->min = mn;
+    if (mx > a->max) a->max = mx;
+    a->count += count;
+    a->errors += errors;
+}
+
+// The dynamic cost model lets -O2 builds vectorize despite the scalar tail
+// of a short block; the scalar set keeps the vectorizer out entirely.
+#define COL_KERNEL_SET(level, attr)                                                                      \
+attr static void col_add_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { col_add_body(r, a, b, f, n); } \
+attr static void col_sub_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { col_sub_body(r, a, b, f, n); } \
+attr static void col_mul_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { col_mul_body(r, a, b, f, n); } \
+attr static void col_div_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { col_div_body(r, a, b, f, n); } \
+attr static void col_mod_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { col_mod_body(r, a, b, f, n); } \
+attr static void col_neg_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)b; col_neg_body(r, a, f, n); } \
+attr static void col_lt_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_lt_body(r, a, b, n); } \
+attr static void col_le_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_le_body(r, a, b, n); } \
+attr static void col_eq_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_eq_body(r, a, b, n); } \
+attr static void col_ne_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_ne_body(r, a, b, n); } \
+attr static void col_land_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_land_body(r, a, b, n); } \
+attr static void col_lor_##level(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) { (void)f; col_lor_body(r, a, b, n); } \
+attr static void col_fold_##level(ColAggregate *a, const long long *v, const unsigned char *f, size_t n) { col_fold_body(a, v, f, n); }
+
+typedef void (*ColKernel)(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n);
+
+typedef struct {
+    ColKernel add, sub, mul, div, mod, neg; // neg ignores b
+    ColKernel lt, le, eq, ne, land, lor;    // these ignore f
+    void (*fold)(ColAggregate *a, const long long *v, const unsigned char *f, size_t n);
+} ColKernels;
+
+#define COL_KERNELS(level) { col_add_##level, col_sub_##level, col_mul_##level, col_div_##level, col_mod_##level, col_neg_##level, \
+                             col_lt_##level, col_le_##level, col_eq_##level, col_ne_##level, col_land_##level, col_lor_##level, \
+                             col_fold_##level }
+
+COL_KERNEL_SET(scalar, __attribute__((optimize("no-tree-vectorize"))))
+#if SIMD_X86
+COL_KERNEL_SET(sse42, __attribute__((target("sse4.2"), optimize("vect-cost-model=dynamic"))))
+COL_KERNEL_SET(avx2, __attribute__((target("avx2"), optimize("vect-cost-model=dynamic"))))
+COL_KERNEL_SET(avx512, __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl"), optimize("vect-cost-model=dynamic"))))
+static const ColKernels col_kernel_sets[SIMD_LEVELS] = {
+    COL_KERNELS(scalar), COL_KERNELS(sse42), COL_KERNELS(avx2), COL_KERNELS(avx512)
+};
+#else
+static const ColKernels col_kernel_sets[SIMD_LEVELS] = {
+    COL_KERNELS(scalar), COL_KERNELS(scalar), COL_KERNELS(scalar), COL_KERNELS(scalar)
+};
+#endif
+
+static void col_pow(long long *r, const long long *a, const long long *b, unsigned char *f, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        long long p = 0;
+        if (!safe_pow_ll(a[i], b[i], &p)) { f[i] |= 1 << COL_ERR_POW; p = 0; }
+        r[i] = p;
+    }
+}
+
+static void col_divc(long long *r, const long long *a, const DivMagic *m, int mod, size_t n) {
+    if (mod) { for (size_t i = 0; i < n; ++i) r[i] = divmagic_mod(m, a[i]); }
+    else     { for (size_t i = 0; i < n; ++i) r[i] = divmagic_div(m, a[i]); }
+}
+
+// r = a op b for any binary operator.
+static void col_binary(const ColKernels *kern, char op, long long *r, const long long *a, const long long *b,
+                       unsigned char *f, size_t n) {
+    switch (op) {
+        case '+': kern->add(r, a, b, f, n); break;
+        case '-': kern->sub(r, a, b, f, n); break;
+        case '*': kern->mul(r, a, b, f, n); break;
+        case '/': kern->div(r, a, b, f, n); break;
+        case '%': kern->mod(r, a, b, f, n); break;
+        case '^': col_pow(r, a, b, f, n); break;
+        case '<': kern->lt(r, a, b, f, n); break;
+        case '>': kern->lt(r, b, a, f, n); break;
+        case 'l': kern->le(r, a, b, f, n); break;
+        case 'g': kern->le(r, b, a, f, n); break;
+        case 'e': kern->eq(r, a, b, f, n); break;
+        case 'n': kern->ne(r, a, b, f, n); break;
+        case '&': kern->land(r, a, b, f, n); break;
+        case '|': kern->lor(r, a, b, f, n); break;
+    }
+}
+
+// Packs per-row flags (NULL: none set) into the bitmaps, 64 rows per word.
+static void col_pack_flags(const ColumnBatch *b, const unsigned char *flags, size_t base, size_t n) {
+    for (size_t w = 0; w * 64 < n; ++w) {
+        uint64_t bits[COL_ERR_KINDS] = { 0 };
+        size_t end = n - w * 64 < 64 ? n - w * 64 : 64;
+        const unsigned char *f = flags + w * 64;
+        for (size_t j = 0; flags && j < end; j += 8) {
+            uint64_t x = 0;
+            memcpy(&x, f + j, end - j < 8 ? end - j : 8);
+            if (!x) continue; // no errors in these 8 rows, the common case
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            // bit e of each byte, gathered into 8 adjacent bits
+            for (int e = 0; e < COL_ERR_KINDS; ++e)
+                bits[e] |= (((x >> e) & 0x0101010101010101ULL) * 0x0102040810204080ULL >> 56) << j;
+#else
+            for (size_t i = j; i < j + 8 && i < end; ++i)
+                for (int e = 0; e < COL_ERR_KINDS; ++e) bits[e] |= (uint64_t)((f[i] >> e) & 1) << i;
+#endif
         }
+        for (int e = 0; e < COL_ERR_KINDS; ++e) b->err[e][base / 64 + w] = bits[e];
+    }
+}
 
-        printf("Postfix: ");
-        print_postfix(&postfix);
+// Runs prog on n rows, reading variable v from cols[v] + base. Returns the
+// results, with their error flags in s->flags.
+static const long long *col_run(const Program *prog, const long long *const *cols, size_t base, size_t n, ColScratch *s) {
+    const ColKernels *kern = &col_kernel_sets[simd_level];
+    int sp = -1;
+    memset(s->flags, 0, n);
 
-        long long value = 0;
-        if (!evaluate_postfix(&postfix, &value, err)) {
-            printf("Error (evaluate): %s\n", err);
-            continue;
+    for (int k = 0; k < prog->count; ++k) {
+        const Instr *ins = &prog->code[k];
+        long long *dst;
+        switch (ins->kind) {
+            case INS_LOAD:
+                s->slot[++sp] = cols[ins->value] + base; // read in place, no copy
+                break;
+            case INS_PUSH:
+                dst = s->buf + (size_t)(++sp) * COL_BLOCK;
+                for (size_t i = 0; i < n; ++i) dst[i] = ins->value;
+                s->slot[sp] = dst;
+                break;
+            case INS_DIVC:
+            case INS_MODC:
+                dst = s->buf + (size_t)sp * COL_BLOCK;
+                col_divc(dst, s->slot[sp], &ins->div, ins->kind == INS_MODC, n);
+                s->slot[sp] = dst;
+                break;
+            case INS_OP:
+                if (ins->op == 'u') {
+                    dst = s->buf + (size_t)sp * COL_BLOCK;
+                    kern->neg(dst, s->slot[sp], NULL, s->flags, n);
+                    s->slot[sp] = dst;
+                    break;
+                }
+                sp--;
+                dst = s->buf + (size_t)sp * COL_BLOCK;
+                col_binary(kern, ins->op, dst, s->slot[sp], s->slot[sp + 1], s->flags, n);
+                s->slot[sp] = dst;
+                break;
         }
-        printf("Result: %lld\n", value);
     }
+    return s->slot[0];
+}
 
-    printf("Goodbye!\n");
-    return 0;
+void col_aggregate_init(ColAggregate *a) {
+    a->sum = 0;
+    a->min = LLONG_MAX;
+    a->max = LLONG_MIN;
+    a->count = a->errors = 0;
+}
+
+static inline void col_aggregate_add(ColAggregate *a, long long v) {
+    a->sum += v;
+    if (v < a->min) a->min = v;
+    if (v > a->max) a->max = v;
+    a->count++;
 }
+
+static pthread_mutex_t col_aggregate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Adds a worker's partial aggregate into the batch's, once per worker.
+static void col_aggregate_merge(ColAggregate *into, const ColAggregate *part) {
+    pthread_mutex_lock(&col_aggregate_lock);
+    into->sum += part->sum;
+    if (part->min < into->min) into->min = part->min;
+    if (part->max > into->max) into->max = part->max;
+    into->count += part->count;
+    into->errors += part->errors;
+    pthread_mutex_unlock(&col_aggregate_lock);
+}
+
+// Folds results into a, leaving out rows that have errors or that b->skip marks.
+static void col_aggregate_block(const ColumnBatch *b, ColAggregate *a, const long long *v, const unsigned char *f,
+                                size_t base, const uint16_t *sel, size_t m) {
+    static const unsigned char no_flags[COL_BLOCK];
+    unsigned char mask[COL_BLOCK];
+    if (b->skip) {
+        for (size_t i = 0; i < m; ++i) {
+            size_t row = base + (sel ? sel[i] : i);
+            mask[i] = (unsigned char)((f ? f[i] : 0) | ((b->skip[row / 64] >> (row % 64)) & 1) << COL_SKIPPED);
+        }
+        f = mask;
+    }
+    col_kernel_sets[simd_level].fold(a, v, f ? f : no_flags, m);
+}
+
+// Stores the results v (flags f) of block [base, base + n): all n rows, or
+// with sel the m rows at offsets sel[0..m) (the others keep stale values).
+// With b->agg they are folded into the worker's partial aggregate instead.
+static void col_store(const ColumnBatch *b, const long long *v, const unsigned char *f, size_t base, size_t n,
+                      const uint16_t *sel, size_t m, ColAggregate *part) {
+    if (b->agg) {
+        col_aggregate_block(b, part, v, f, base, sel, sel ? m : n);
+        return;
+    }
+    if (!sel) {
+        memcpy(b->out + base, v, n * sizeof(long long));
+        col_pack_flags(b, f, base, n);
+        return;
+    }
+    for (int e = 0; e < COL_ERR_KINDS; ++e) memset(b->err[e] + base / 64, 0, (n + 63) / 64 * sizeof(uint64_t));
+    for (size_t i = 0; i < m; ++i) {
+        size_t row = base + sel[i];
+        b->out[row] = v[i];
+        for (int e = 0; f && f[i] && e < COL_ERR_KINDS; ++e) b->err[e][row / 64] |= (uint64_t)((f[i] >> e) & 1) << (row % 64);
+    }
+}
+
+// Rows [base, base + n) of the batch; base is a multiple of COL_BLOCK.
+static void col_run_block(const Program *prog, const ColumnBatch *b, size_t base, size_t n, ColScratch *s) {
+    col_store(b, col_run(prog, b->cols, base, n, s), s->flags, base, n, NULL, n, &s->agg);
+}
+
+typedef struct {
+    const Program *prog;
+    const ColumnBatch *b;
+    size_t morsels;
+    atomic_size_t next;            // next unclaimed morsel
+} ColJob;
+
+// One worker: claims morsels until none are left.
+static void col_worker(void *ctx, size_t begin, size_t end) {
+    ColJob *job = ctx;
+    const ColumnBatch *b = job->b;
+    (void)begin; (void)end;
+
+    ColScratch *s = malloc(sizeof(ColScratch));
+    if (s) s->buf = malloc((size_t)job->prog->depth * COL_BLOCK * sizeof(long long));
+    if (s) s->slot = s->buf ? malloc((size_t)job->prog->depth * sizeof(long long *)) : NULL;
+    if (!s || !s->slot) { // out of memory: leave the morsels to the other workers
+        if (s) free(s->buf);
+        free(s);
+        return;
+    }
+    col_aggregate_init(&s->agg);
+
+    size_t m;
+    while ((m = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->morsels) {
+        size_t last = (m + 1) * COL_MORSEL < b->rows ? (m + 1) * COL_MORSEL : b->rows;
+        for (size_t base = m * COL_MORSEL; base < last; base += COL_BLOCK)
+            col_run_block(job->prog, b, base, last - base < COL_BLOCK ? last - base : COL_BLOCK, s);
+    }
+    if (b->agg) col_aggregate_merge(b->agg, &s->agg);
+    free(s->slot);
+    free(s->buf);
+    free(s);
+}
+
+// prog must have passed program_check. 0 if out of memory, when some rows
+// were left unevaluated.
+static int columnar_try_evaluate(const Program *prog, const ColumnBatch *b) {
+    ColJob job = { prog, b, (b->rows + COL_MORSEL - 1) / COL_MORSEL, 0 };
+    atomic_init(&job.next, 0);
+    size_t workers = job.morsels < (size_t)num_threads ? job.morsels : (size_t)num_threads;
+    parallel_for(workers ? workers : 1, 1, col_worker, &job);
+    return atomic_load(&job.next) >= job.morsels;
+}
+
+void columnar_evaluate(const Program *prog, const ColumnBatch *b) {
+    if (!columnar_try_evaluate(prog, b)) { fputs("Out of memory\n", stderr); exit(1); }
+}
+
+// Index of the first error kind set for row i, or -1.
+int columnar_row_error(const ColumnBatch *b, size_t i) {
+    for (int e = 0; e < COL_ERR_KINDS; ++e)
+        if ((b->err[e][i / 64] >> (i % 64)) & 1) return e;
+    return -1;
+}
+
+// 0 if out of memory, with nothing left allocated.
+static int column_batch_try_alloc(ColumnBatch *b, size_t rows) {
+    size_t words = (rows + 63) / 64 + 1;
+    int ok;
+    b->rows = rows;
+    b->selected = NULL;
+    b->agg = NULL;
+    b->skip = NULL;
+    ok = (b->out = malloc((rows + 1) * sizeof(long long))) != NULL;
+    for (int e = 0; e < COL_ERR_KINDS; ++e) ok &= (b->err[e] = malloc(words * sizeof(uint64_t))) != NULL;
+    if (!ok) {
+        for (int e = 0; e < COL_ERR_KINDS; ++e) free(b->err[e]);
+        free(b->out);
+    }
+    return ok;
+}
+
+static void column_batch_alloc(ColumnBatch *b, size_t rows) {
+    if (!column_batch_try_alloc(b, rows)) { fputs("Out of memory\n", stderr); exit(1); }
+}
+
+static void column_batch_free(ColumnBatch *b) {
+    for (int e = 0; e < COL_ERR_KINDS; ++e) free(b->err[e]);
+    free(b->out);
+}
+
+// Whether row i is part of the output: kept by --where, or any row without one.
+static inline int columnar_row_selected(const ColumnBatch *b, size_t i) {
+    return !b->selected || ((b->selected[i / 64] >> (i % 64)) & 1);
+}
+
+// -------------------- Fused multi-formula evaluation --------------------
+// --batch "f1; f2; ..." evaluates several formulas over the same rows in one
+// pass. Each formula's program is run symbolically into one DAG whose nodes
+// are hash-consed, so a subexpression shared between formulas (up to the
+// operand order of + and *) is computed once. Each block of rows then runs
+// the whole DAG, so every input column is read once while it is hot for all
+// formulas. Nodes carry their own error flags (their operands' plus their
+// own), so a failing subexpression only marks the formulas built on it, and
+// a node's register is reused as soon as its last reader has run.
+#define MAX_FORMULAS    64
+#define MAX_CONJUNCTS   32
+#define FUSED_MAX_NODES (4 * MAX_TOKENS)
+#define FUSED_HASH_SIZE (2 * FUSED_MAX_NODES) // a power of two
+
+typedef struct {
+    int kind;            // INS_* as in Program
+    char op;             // INS_OP
+    long long value;     // literal, variable index or divisor
+    DivMagic div;        // INS_DIVC / INS_MODC
+    int a, b;            // operand nodes, or -1
+    int reg;             // register holding the result; -1 for loads
+} FusedNode;
+
+typedef struct {
+    int nout;
+    Program *prog[MAX_FORMULAS];    // each formula compiled on its own
+    int nvars;                      // union of the formulas' variables, in order of first appearance
+    const char *var_name[MAX_VARS];
+    int var_len[MAX_VARS];
+    FusedNode *node;                // the DAG in evaluation order, when nout > 1
+    int count, nregs;
+    int root[MAX_FORMULAS];         // node computing each formula
+    int order[MAX_FORMULAS];        // formulas sorted by root
+    int nconj;                      // --where: the predicate's top-level && operands
+    Program *conj[MAX_CONJUNCTS];
+    uint64_t conj_vars[MAX_CONJUNCTS], out_vars; // variables each conjunct and the formulas read
+} FormulaSet;
+
+static int formula_set_var(FormulaSet *fs, const char *name, int len, char *err_msg) {
+    for (int v = 0; v < fs->nvars; ++v)
+        if (fs->var_len[v] == len && memcmp(fs->var_name[v], name, (size_t)len) == 0) return v;
+    if (fs->nvars >= MAX_VARS) { strcpy(err_msg,"Too many variables"); return -1; }
+    fs->var_name[fs->nvars] = name;
+    fs->var_len[fs->nvars] = len;
+    return fs->nvars++;
+}
+
+// Index of the node equal to n, adding it if it is new; -1 if the DAG is full.
+static int fused_node(FormulaSet *fs, int *table, FusedNode n) {
+    if (n.kind == INS_OP && strchr("+*en&|", n.op) && n.a > n.b) { int t = n.a; n.a = n.b; n.b = t; }
+    uint64_t h = ((uint64_t)n.kind * 31 + (uint64_t)(unsigned char)n.op) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (uint64_t)n.value) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ ((uint64_t)(unsigned)n.a << 32 | (unsigned)n.b)) * 0x9E3779B97F4A7C15ULL;
+    for (size_t i = (size_t)(h >> 40) & (FUSED_HASH_SIZE - 1);; i = (i + 1) & (FUSED_HASH_SIZE - 1)) {
+        int k = table[i];
+        if (k < 0) {
+            if (fs->count == FUSED_MAX_NODES) return -1;
+            n.reg = -1;
+            fs->node[fs->count] = n;
+            return table[i] = fs->count++;
+        }
+        const FusedNode *m = &fs->node[k];
+        if (m->kind == n.kind && m->op == n.op && m->value == n.value && m->a == n.a && m->b == n.b) return k;
+    }
+}
+
+static int formula_set_build(FormulaSet *fs, char *err_msg) {
+    int *table = malloc(FUSED_HASH_SIZE * sizeof(int)), *stk = malloc(MAX_TOKENS * sizeof(int));
+    int *free_regs = malloc(FUSED_MAX_NODES * sizeof(int)), nfree = 0;
+    fs->node = malloc(FUSED_MAX_NODES * sizeof(FusedNode));
+    if (!table || !stk || !free_regs || !fs->node) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int i = 0; i < FUSED_HASH_SIZE; ++i) table[i] = -1;
+
+    int ok = 1;
+    for (int f = 0; ok && f < fs->nout; ++f) {
+        const Program *p = fs->prog[f];
+        int sp = -1;
+        for (int i = 0; ok && i < p->count; ++i) {
+            const Instr *ins = &p->code[i];
+            FusedNode n = { ins->kind, 0, 0, { 0, 0, 0, 0 }, -1, -1, -1 };
+            switch (ins->kind) {
+                case INS_PUSH:
+                case INS_LOAD: n.value = ins->value; sp++; break;
+                case INS_DIVC:
+                case INS_MODC: n.value = ins->div.d; n.div = ins->div; n.a = stk[sp]; break;
+                case INS_OP:
+                    n.op = ins->op;
+                    if (ins->op != 'u') sp--, n.b = stk[sp + 1];
+                    n.a = stk[sp];
+                    break;
+            }
+            ok = (stk[sp] = fused_node(fs, table, n)) >= 0;
+        }
+        fs->root[f] = stk[0];
+    }
+    if (!ok) strcpy(err_msg,"Formulas are too large to evaluate together");
+
+    // Registers: a node's register is freed after its last reader, and a root
+    // is written out as soon as it is computed.
+    int *last = table;
+    for (int k = 0; ok && k < fs->count; ++k) last[k] = k;
+    for (int k = 0; ok && k < fs->count; ++k) {
+        if (fs->node[k].a >= 0) last[fs->node[k].a] = k;
+        if (fs->node[k].b >= 0) last[fs->node[k].b] = k;
+    }
+    fs->nregs = 0;
+    for (int k = 0; ok && k < fs->count; ++k) {
+        FusedNode *n = &fs->node[k];
+        if (n->kind == INS_LOAD) continue;
+        if (n->a >= 0 && last[n->a] == k && fs->node[n->a].reg >= 0) free_regs[nfree++] = fs->node[n->a].reg;
+        if (n->b >= 0 && n->b != n->a && last[n->b] == k && fs->node[n->b].reg >= 0) free_regs[nfree++] = fs->node[n->b].reg;
+        n->reg = nfree ? free_regs[--nfree] : fs->nregs++;
+        if (last[k] == k) free_regs[nfree++] = n->reg;
+    }
+
+    for (int f = 0; f < fs->nout; ++f) {
+        int j = f;
+        for (; j > 0 && fs->root[fs->order[j - 1]] > fs->root[f]; --j) fs->order[j] = fs->order[j - 1];
+        fs->order[j] = f;
+    }
+    free(free_regs);
+    free(stk);
+    free(table);
+    return ok;
+}
+
+// Adds the conjuncts in postfix items [lo, hi) of a checked predicate.
+static int formula_set_split(FormulaSet *fs, const TokenList *pred, int lo, int hi, TokenList *part, char *err_msg) {
+    if (pred->items[hi - 1].op == '&') {
+        int mid = hi - 1; // walk back over the right operand
+        for (int need = 1; need; ) {
+            const Token *t = &pred->items[--mid];
+            need += !t->op ? -1 : t->op != 'u';
+        }
+        return formula_set_split(fs, pred, lo, mid, part, err_msg) && formula_set_split(fs, pred, mid, hi - 1, part, err_msg);
+    }
+    if (fs->nconj == MAX_CONJUNCTS) { strcpy(err_msg,"Too many && conditions"); return 0; }
+    Program *p = fs->conj[fs->nconj++] = malloc(sizeof(Program));
+    if (!p) { fputs("Out of memory\n", stderr); exit(1); }
+    memcpy(part->items, pred->items + lo, (size_t)(hi - lo) * sizeof(Token));
+    part->count = hi - lo;
+    return compile_postfix(part, p, err_msg) && program_check(p, err_msg);
+}
+
+// Points p's loads at the set's variables; returns the variables it reads.
+static uint64_t formula_set_bind(FormulaSet *fs, Program *p) {
+    uint64_t vars = 0;
+    for (int i = 0; i < p->count; ++i) {
+        Instr *ins = &p->code[i];
+        if (ins->kind != INS_LOAD) continue;
+        ins->value = formula_set_var(fs, p->var_name[ins->value], p->var_len[ins->value], NULL); // already known
+        vars |= 1ULL << ins->value;
+    }
+    return vars;
+}
+
+// Compiles the ';'-separated formulas in text, which is split in place and
+// must outlive the set, and the predicate where (NULL for none).
+int formula_set_compile(FormulaSet *fs, char *text, const char *where, char *err_msg) {
+    TokenList *postfix = malloc(sizeof(TokenList)), *part = malloc(sizeof(TokenList));
+    if (!postfix || !part) { fputs("Out of memory\n", stderr); exit(1); }
+    fs->nout = fs->nvars = fs->count = fs->nconj = 0;
+    fs->node = NULL;
+
+    int ok = 1;
+    for (char *f = text, *next; ok && f; f = next) {
+        if ((next = strchr(f, ';'))) *next++ = '\0';
+        if (fs->nout == MAX_FORMULAS) { strcpy(err_msg,"Too many formulas"); ok = 0; break; }
+        Program *p = fs->prog[fs->nout++] = malloc(sizeof(Program));
+        char e[128] = {0};
+        if (!p) { fputs("Out of memory\n", stderr); exit(1); }
+        if (!batch_compile(f, postfix, p, e)) {
+            if (fs->nout > 1 || next) snprintf(err_msg, 128, "Formula %d: %s", fs->nout, e);
+            else strcpy(err_msg, e);
+            ok = 0;
+        }
+        for (int v = 0; ok && v < p->nvars; ++v) ok = formula_set_var(fs, p->var_name[v], p->var_len[v], err_msg) >= 0;
+    }
+    if (ok && where) {
+        Program *whole = malloc(sizeof(Program));
+        char e[128] = {0};
+        if (!whole) { fputs("Out of memory\n", stderr); exit(1); }
+        ok = batch_compile(where, postfix, whole, e) && formula_set_split(fs, postfix, 0, postfix->count, part, e);
+        if (!ok) snprintf(err_msg, 128, "Predicate: %s", e);
+        for (int v = 0; ok && v < whole->nvars; ++v) ok = formula_set_var(fs, whole->var_name[v], whole->var_len[v], err_msg) >= 0;
+        free(whole);
+    }
+
+    // From here on, loads index the set's variables
+    fs->out_vars = 0;
+    for (int f = 0; ok && f < fs->nout; ++f) fs->out_vars |= formula_set_bind(fs, fs->prog[f]);
+    for (int c = 0; ok && c < fs->nconj; ++c) fs->conj_vars[c] = formula_set_bind(fs, fs->conj[c]);
+    free(part);
+    free(postfix);
+    return ok && (fs->nout == 1 || formula_set_build(fs, err_msg));
+}
+
+void formula_set_free(FormulaSet *fs) {
+    for (int f = 0; f < fs->nout; ++f) free(fs->prog[f]);
+    for (int c = 0; c < fs->nconj; ++c) free(fs->conj[c]);
+    free(fs->node);
+    fs->nout = fs->nconj = 0;
+    fs->node = NULL;
+}
+
+typedef struct {
+    long long *buf;                // nregs registers of COL_BLOCK values
+    unsigned char *flags;          // and of COL_BLOCK error flags
+    const long long **slot;        // each node's values for this block
+    const unsigned char **flag;    // each node's flags, NULL if none
+    ColAggregate *agg;             // this worker's share of each formula's aggregate
+} FusedScratch;
+
+// A node's flags start as the union of its operands'; r may be a or b.
+__attribute__((optimize("vect-cost-model=dynamic")))
+static void fused_or_flags(unsigned char *r, const unsigned char *a, const unsigned char *b, size_t n) {
+#pragma GCC ivdep
+    for (size_t i = 0; i < n; ++i) r[i] = a[i] | b[i];
+}
+
+__attribute__((optimize("vect-cost-model=dynamic")))
+static void fused_fill(long long *r, long long v, size_t n) {
+    for (size_t i = 0; i < n; ++i) r[i] = v;
+}
+
+// Every formula over n rows read from cols[v] + in_base; b[f] receives
+// formula f through col_store(..., base, block, sel, n).
+static void fused_run(const FormulaSet *fs, const long long *const *cols, size_t in_base, size_t n,
+                      const ColumnBatch *b, size_t base, size_t block, const uint16_t *sel, FusedScratch *s) {
+    const ColKernels *kern = &col_kernel_sets[simd_level];
+    int o = 0;
+
+    for (int k = 0; k < fs->count; ++k) {
+        const FusedNode *nd = &fs->node[k];
+        long long *dst = s->buf + (size_t)(nd->reg < 0 ? 0 : nd->reg) * COL_BLOCK;
+        unsigned char *fl = s->flags + (size_t)(nd->reg < 0 ? 0 : nd->reg) * COL_BLOCK;
+        const unsigned char *fa = nd->a >= 0 ? s->flag[nd->a] : NULL, *fb = nd->b >= 0 ? s->flag[nd->b] : NULL;
+
+        s->slot[k] = dst;
+        s->flag[k] = NULL;
+        switch (nd->kind) {
+            case INS_LOAD:
+                s->slot[k] = cols[nd->value] + in_base; // read in place, no copy
+                break;
+            case INS_PUSH:
+                fused_fill(dst, nd->value, n);
+                break;
+            case INS_DIVC:
+            case INS_MODC:
+                col_divc(dst, s->slot[nd->a], &nd->div, nd->kind == INS_MODC, n);
+                if (fa) { memmove(fl, fa, n); s->flag[k] = fl; }
+                break;
+            case INS_OP:
+                if (fa && fb) fused_or_flags(fl, fa, fb, n);
+                else if (fa || fb) memmove(fl, fa ? fa : fb, n);
+                else memset(fl, 0, n);
+                s->flag[k] = fl;
+                if (nd->op == 'u') kern->neg(dst, s->slot[nd->a], NULL, fl, n);
+                else col_binary(kern, nd->op, dst, s->slot[nd->a], s->slot[nd->b], fl, n);
+                break;
+        }
+        for (; o < fs->nout && fs->root[fs->order[o]] == k; ++o)
+            col_store(&b[fs->order[o]], s->slot[k], s->flag[k], base, block, sel, n, &s->agg[fs->order[o]]);
+    }
+}
+
+// Rows [base, base + n) for every formula.
+static void fused_run_block(const FormulaSet *fs, const ColumnBatch *b, size_t base, size_t n, FusedScratch *s) {
+    fused_run(fs, b[0].cols, base, n, b, base, n, NULL, s);
+}
+
+typedef struct {
+    const FormulaSet *fs;
+    const ColumnBatch *b;
+    size_t morsels;
+    atomic_size_t next;            // next unclaimed morsel
+} FusedJob;
+
+static void fused_scratch_alloc(FusedScratch *s, const FormulaSet *fs) {
+    size_t regs = (size_t)(fs->nregs > 0 ? fs->nregs : 1);
+    s->buf = malloc(regs * COL_BLOCK * sizeof(long long));
+    s->flags = malloc(regs * COL_BLOCK);
+    s->slot = malloc((size_t)fs->count * sizeof(long long *));
+    s->flag = malloc((size_t)fs->count * sizeof(unsigned char *));
+    s->agg = malloc((size_t)fs->nout * sizeof(ColAggregate));
+    if (!s->buf || !s->flags || !s->slot || !s->flag || !s->agg) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int f = 0; f < fs->nout; ++f) col_aggregate_init(&s->agg[f]);
+}
+
+// Frees s after merging its partial aggregates into b's.
+static void fused_scratch_free(FusedScratch *s, const FormulaSet *fs, const ColumnBatch *b) {
+    for (int f = 0; f < fs->nout; ++f) if (b[f].agg) col_aggregate_merge(b[f].agg, &s->agg[f]);
+    free(s->agg);
+    free(s->flag);
+    free(s->slot);
+    free(s->flags);
+    free(s->buf);
+}
+
+static void fused_worker(void *ctx, size_t begin, size_t end) {
+    FusedJob *job = ctx;
+    const FormulaSet *fs = job->fs;
+    size_t rows = job->b[0].rows;
+    (void)begin; (void)end;
+
+    FusedScratch s;
+    fused_scratch_alloc(&s, fs);
+    size_t m;
+    while ((m = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->morsels) {
+        size_t last = (m + 1) * COL_MORSEL < rows ? (m + 1) * COL_MORSEL : rows;
+        for (size_t base = m * COL_MORSEL; base < last; base += COL_BLOCK)
+            fused_run_block(fs, job->b, base, last - base < COL_BLOCK ? last - base : COL_BLOCK, &s);
+    }
+    fused_scratch_free(&s, fs, job->b);
+}
+
+// -------------------- Filtered evaluation --------------------
+// --where PREDICATE keeps the rows on which the predicate is true: non-zero
+// and free of errors. The predicate is split at its top-level && into
+// conjuncts, which run one after another on the rows still selected in a
+// block, kept as a selection vector of offsets into it. Once rows have been
+// dropped, the variables a later program reads are gathered into dense
+// registers, so each conjunct and then the formulas only compute surviving
+// rows. Every worker measures the rows each conjunct drops and the time it
+// takes on the first block of each morsel, which keeps the clock reads off
+// the other blocks, and before each morsel runs first the conjunct that
+// drops the most rows per second; the counts are halved every morsel to
+// follow the data.
+typedef struct {
+    double in, out, seconds;       // rows seen and kept, and time spent
+} ConjStats;
+
+typedef struct {
+    ColScratch col;                // conjuncts, and the formula when there is only one
+    FusedScratch fused;            // the formulas when there are several
+    long long *gather;             // a COL_BLOCK register per variable
+    uint16_t sel[COL_BLOCK];       // the block's selected rows
+    int order[MAX_CONJUNCTS];      // conjuncts in the order they run
+    ConjStats stats[MAX_CONJUNCTS];
+} FilterScratch;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Gathers the selected rows of the variables in vars into their registers.
+static void filter_gather(const ColumnBatch *b, uint64_t vars, size_t base, size_t m, FilterScratch *s,
+                          const long long **cols) {
+    for (; vars; vars &= vars - 1) {
+        int v = __builtin_ctzll(vars);
+        long long *dst = s->gather + (size_t)v * COL_BLOCK;
+        const long long *src = b->cols[v] + base;
+        for (size_t i = 0; i < m; ++i) dst[i] = src[s->sel[i]];
+        cols[v] = dst;
+    }
+}
+
+// Conjuncts by rows dropped per second, unmeasured ones first.
+static void filter_reorder(int nconj, FilterScratch *s) {
+    double rank[MAX_CONJUNCTS];
+    for (int c = 0; c < nconj; ++c) {
+        ConjStats *st = &s->stats[c];
+        rank[c] = st->in > 0 ? (st->in - st->out) / (st->seconds + 1e-9) : HUGE_VAL;
+        st->in *= 0.5; st->out *= 0.5; st->seconds *= 0.5;
+    }
+    for (int c = 1; c < nconj; ++c) {
+        int k = s->order[c], j = c;
+        for (; j > 0 && rank[s->order[j - 1]] < rank[k]; --j) s->order[j] = s->order[j - 1];
+        s->order[j] = k;
+    }
+}
+
+// timed: measure the conjuncts on this block.
+static void filter_run_block(const FormulaSet *fs, const ColumnBatch *b, size_t base, size_t n, FilterScratch *s,
+                             int timed) {
+    const long long *cols[MAX_VARS];
+    uint64_t ready = ~0ULL;        // variables cols holds for the selected rows
+    size_t m = n;
+    for (int v = 0; v < fs->nvars; ++v) cols[v] = b->cols[v] + base;
+
+    for (int c = 0; c < fs->nconj && m; ++c) {
+        int j = s->order[c];
+        double start = timed ? now_seconds() : 0;
+        filter_gather(b, fs->conj_vars[j] & ~ready, base, m, s, cols);
+        ready |= fs->conj_vars[j];
+        const long long *r = col_run(fs->conj[j], cols, 0, m, &s->col);
+        size_t kept = 0;
+        for (size_t i = 0; i < m; ++i) {
+            s->sel[kept] = m == n ? (uint16_t)i : s->sel[i];
+            kept += (r[i] != 0) & (s->col.flags[i] == 0);
+        }
+        if (kept < m) ready = 0;
+        if (timed) {
+            s->stats[j].in += (double)m;
+            s->stats[j].out += (double)kept;
+            s->stats[j].seconds += now_seconds() - start;
+        }
+        m = kept;
+    }
+
+    uint64_t *selected = b[0].selected + base / 64;
+    memset(selected, 0, (n + 63) / 64 * sizeof(uint64_t));
+    for (size_t i = 0; i < m; ++i) selected[s->sel[i] / 64] |= 1ULL << (s->sel[i] % 64);
+    if (!m) return;
+
+    const uint16_t *sel = m < n ? s->sel : NULL;
+    filter_gather(b, fs->out_vars & ~ready, base, m, s, cols);
+    if (fs->nout == 1) col_store(&b[0], col_run(fs->prog[0], cols, 0, m, &s->col), s->col.flags, base, n, sel, m, &s->col.agg);
+    else fused_run(fs, cols, 0, m, b, base, n, sel, &s->fused);
+}
+
+static void filter_worker(void *ctx, size_t begin, size_t end) {
+    FusedJob *job = ctx;
+    const FormulaSet *fs = job->fs;
+    size_t rows = job->b[0].rows, depth = 1;
+    (void)begin; (void)end;
+
+    FilterScratch *s = calloc(1, sizeof(FilterScratch));
+    if (!s) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int c = 0; c < fs->nconj; ++c) if ((size_t)fs->conj[c]->depth > depth) depth = (size_t)fs->conj[c]->depth;
+    if (fs->nout == 1 && (size_t)fs->prog[0]->depth > depth) depth = (size_t)fs->prog[0]->depth;
+    else if (fs->nout > 1) fused_scratch_alloc(&s->fused, fs);
+    s->col.buf = malloc(depth * COL_BLOCK * sizeof(long long));
+    s->col.slot = malloc(depth * sizeof(long long *));
+    s->gather = malloc((size_t)(fs->nvars ? fs->nvars : 1) * COL_BLOCK * sizeof(long long));
+    if (!s->col.buf || !s->col.slot || !s->gather) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int c = 0; c < fs->nconj; ++c) s->order[c] = c;
+    col_aggregate_init(&s->col.agg);
+
+    size_t m;
+    while ((m = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->morsels) {
+        size_t last = (m + 1) * COL_MORSEL < rows ? (m + 1) * COL_MORSEL : rows;
+        filter_reorder(fs->nconj, s);
+        for (size_t base = m * COL_MORSEL; base < last; base += COL_BLOCK)
+            filter_run_block(fs, job->b, base, last - base < COL_BLOCK ? last - base : COL_BLOCK, s, base == m * COL_MORSEL);
+    }
+    if (fs->nout > 1) fused_scratch_free(&s->fused, fs, job->b);
+    else if (job->b[0].agg) col_aggregate_merge(job->b[0].agg, &s->col.agg);
+    free(s->gather);
+    free(s->col.slot);
+    free(s->col.buf);
+    free(s);
+}
+
+// b holds one batch per formula; all share rows and cols (indexed by the
+// set's variables), and with a predicate the selected bitmap.
+void formula_set_evaluate(const FormulaSet *fs, const ColumnBatch *b) {
+    if (fs->nout == 1 && !fs->nconj) { columnar_evaluate(fs->prog[0], b); return; }
+    FusedJob job = { fs, b, (b[0].rows + COL_MORSEL - 1) / COL_MORSEL, 0 };
+    atomic_init(&job.next, 0);
+    size_t workers = job.morsels < (size_t)num_threads ? job.morsels : (size_t)num_threads;
+    parallel_for(workers ? workers : 1, 1, fs->nconj ? filter_worker : fused_worker, &job);
+}
+
+// One batch of rows outputs per formula of fs, sharing cols.
+static ColumnBatch *column_batches_alloc(const FormulaSet *fs, size_t rows, const long long **cols) {
+    ColumnBatch *b = malloc((size_t)fs->nout * sizeof(ColumnBatch));
+    uint64_t *selected = fs->nconj ? malloc(((rows + 63) / 64 + 1) * sizeof(uint64_t)) : NULL;
+    if (!b || (fs->nconj && !selected)) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int f = 0; f < fs->nout; ++f) {
+        column_batch_alloc(&b[f], rows);
+        b[f].cols = cols;
+        b[f].selected = selected;
+    }
+    return b;
+}
+
+static void column_batches_free(const FormulaSet *fs, ColumnBatch *b) {
+    free(b[0].selected);
+    for (int f = 0; f < fs->nout; ++f) column_batch_free(&b[f]);
+    free(b);
+}
+
+// -------------------- Compressed execution --------------------
+// Dictionary-encoded and run-length encoded inputs are evaluated without
+// expanding them when the formula only reads such columns: with a single
+// dictionary column the formula runs once per dictionary entry, and when
+// every variable is run-length encoded their run boundaries are merged and
+// it runs once per merged run (a constant formula is one run). Results are
+// then broadcast to rows through the codes or runs. Any other mix is decoded
+// and evaluated row by row.
+enum { ENC_PLAIN, ENC_DICT, ENC_RLE };
+
+typedef struct {
+    int kind;
+    const long long *values;       // one per row, the dictionary, or one per run
+    size_t n;                      // ENC_DICT / ENC_RLE: dictionary size or run count
+    const uint32_t *codes;         // ENC_DICT: per-row index into values
+    const uint64_t *ends;          // ENC_RLE: run k covers rows [ends[k - 1], ends[k])
+} EncodedColumn;
+
+typedef struct {
+    int kind;                      // how evaluated rows map back to table rows
+    size_t n;                      // rows to evaluate
+    const long long *cols[MAX_VARS];
+    long long *owned[MAX_VARS];    // arrays built for the plan
+    const uint32_t *codes;         // ENC_DICT
+    uint64_t *ends;                // ENC_RLE (owned)
+} EncodedPlan;
+
+// Expands c to rows values; NULL if out of memory.
+static long long *encoded_decode(const EncodedColumn *c, size_t rows) {
+    long long *v = malloc((rows + 1) * sizeof(long long));
+    if (!v) return NULL;
+    if (c->kind == ENC_DICT) {
+        for (size_t i = 0; i < rows; ++i) v[i] = c->values[c->codes[i]];
+    } else {
+        for (size_t k = 0, i = 0; k < c->n; ++k)
+            for (; i < c->ends[k]; ++i) v[i] = c->values[k];
+    }
+    return v;
+}
+
+void encoded_plan_free(EncodedPlan *p) {
+    for (int k = 0; k < MAX_VARS; ++k) free(p->owned[k]);
+    free(p->ends);
+}
+
+// Chooses how to evaluate nvars columns of rows rows. 0 if out of memory,
+// with nothing left to free.
+int encoded_plan(EncodedPlan *p, const EncodedColumn *cols, int nvars, size_t rows) {
+    int all_rle = 1;
+    for (int k = 0; k < nvars; ++k) all_rle &= cols[k].kind == ENC_RLE;
+    memset(p, 0, sizeof(*p));
+
+    if (nvars == 1 && cols[0].kind == ENC_DICT && cols[0].n < rows) {
+        p->kind = ENC_DICT;
+        p->n = cols[0].n;
+        p->cols[0] = cols[0].values;
+        p->codes = cols[0].codes;
+        return 1;
+    }
+    if (all_rle) {
+        // Merge the run ends: each merged run lies within one run of every column.
+        size_t cap = 1, pos[MAX_VARS] = { 0 };
+        for (int k = 0; k < nvars; ++k) cap += cols[k].n;
+        p->kind = ENC_RLE;
+        p->ends = malloc(cap * sizeof(uint64_t));
+        for (int k = 0; k < nvars; ++k) p->cols[k] = p->owned[k] = malloc(cap * sizeof(long long));
+        int ok = p->ends != NULL;
+        for (int k = 0; k < nvars; ++k) ok &= p->owned[k] != NULL;
+        if (!ok) { encoded_plan_free(p); return 0; }
+        for (uint64_t start = 0; start < rows; start = p->ends[p->n++]) {
+            uint64_t end = rows;
+            for (int k = 0; k < nvars; ++k) {
+                while (cols[k].ends[pos[k]] <= start) pos[k]++;
+                if (cols[k].ends[pos[k]] < end) end = cols[k].ends[pos[k]];
+                p->owned[k][p->n] = cols[k].values[pos[k]];
+            }
+            p->ends[p->n] = end;
+        }
+        return 1;
+    }
+    p->kind = ENC_PLAIN;
+    p->n = rows;
+    for (int k = 0; k < nvars; ++k) {
+        if (cols[k].kind == ENC_PLAIN) { p->cols[k] = cols[k].values; continue; }
+        if (!(p->cols[k] = p->owned[k] = encoded_decode(&cols[k], rows))) { encoded_plan_free(p); return 0; }
+    }
+    return 1;
+}
+
+
+// Evaluated row holding table row i; rows must be visited in order, with
+// *run starting at 0.
+static inline size_t encoded_row(const EncodedPlan *p, size_t i, size_t *run) {
+    if (p->kind == ENC_PLAIN) return i;
+    if (p->kind == ENC_DICT) return p->codes[i];
+    while (i >= p->ends[*run]) ++*run;
+    return *run;
+}
+
+// Whether table row i, evaluated as row j, is kept by b's predicate. Rows
+// with a missing or bad input cannot satisfy one.
+static inline int encoded_row_selected(const ColumnBatch *b, size_t i, size_t j, const uint64_t *missing, const uint64_t *bad) {
+    return !b->selected || (((b->selected[j / 64] >> (j % 64)) & ~((missing[i / 64] | bad[i / 64]) >> (i % 64))) & 1);
+}
+
+// Table rows kept by b's predicate (all rows without one).
+size_t encoded_selected_rows(const EncodedPlan *plan, const ColumnBatch *b, size_t rows, const uint64_t *missing,
+                             const uint64_t *bad) {
+    size_t run = 0, kept = 0;
+    if (!b->selected) return rows;
+    for (size_t i = 0; i < rows; ++i) kept += (size_t)encoded_row_selected(b, i, encoded_row(plan, i, &run), missing, bad);
+    return kept;
+}
+
+// Table-row results of b, evaluated under plan, into values (which may be
+// b->out itself for a plain plan) and a validity bitmap with rows that are
+// missing, bad or in error cleared. With a predicate only the kept rows are
+// written, packed together. Returns the number of cleared rows.
+size_t encoded_expand(const EncodedPlan *plan, const ColumnBatch *b, size_t rows, const uint64_t *missing,
+                      const uint64_t *bad, long long *values, uint64_t *validity) {
+    size_t words = (rows + 63) / 64, run = 0, nulls = 0;
+    if (b->selected) {
+        size_t k = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            size_t j = encoded_row(plan, i, &run);
+            if (!encoded_row_selected(b, i, j, missing, bad)) continue;
+            int ok = columnar_row_error(b, j) < 0;
+            if (k % 64 == 0) validity[k / 64] = 0;
+            values[k] = b->out[j];
+            validity[k / 64] |= (uint64_t)ok << (k % 64);
+            nulls += (size_t)!ok;
+            k++;
+        }
+        return nulls;
+    }
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t skip = missing[w] | bad[w];
+        size_t end = w + 1 < words || rows % 64 == 0 ? 64 : rows % 64;
+        if (plan->kind == ENC_PLAIN) {
+            for (int e = 0; e < COL_ERR_KINDS; ++e) skip |= b->err[e][w];
+            if (values != b->out) memcpy(values + w * 64, b->out + w * 64, end * sizeof(long long));
+        } else {
+            for (size_t i = w * 64; i < w * 64 + end; ++i) {
+                size_t j = encoded_row(plan, i, &run);
+                values[i] = b->out[j];
+                skip |= (uint64_t)(columnar_row_error(b, j) >= 0) << (i % 64);
+            }
+        }
+        validity[w] = ~skip & (end == 64 ? ~0ULL : (1ULL << end) - 1);
+        nulls += end - (size_t)__builtin_popcountll(validity[w]);
+    }
+    return nulls;
+}
+
+// Folds b's results for the table rows kept under plan into a (for plans
+// that evaluated dictionary entries or runs rather than rows).
+void encoded_aggregate(const EncodedPlan *plan, const ColumnBatch *b, size_t rows, const uint64_t *missing,
+                       const uint64_t *bad, ColAggregate *a) {
+    size_t run = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        size_t j = encoded_row(plan, i, &run);
+        if (((missing[i / 64] | bad[i / 64]) >> (i % 64)) & 1 || !columnar_row_selected(b, j)) continue;
+        if (columnar_row_error(b, j) >= 0) a->errors++;
+        else col_aggregate_add(a, b->out[j]);
+    }
+}
+
+// -------------------- Arena allocator --------------------
+// Bignum limbs live in an arena that is reset after every line; blocks are
+// kept between lines, so steady-state evaluation does not call malloc.
+#define ARENA_BLOCK_MIN (1 << 20)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t cap, used;
+    _Alignas(16) unsigned char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *first;
+    ArenaBlock *cur;
+} Arena;
+
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+void arena_init(Arena *a) { a->first = a->cur = NULL; }
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    ArenaBlock *b = a->cur;
+    while (b && b->used + size > b->cap) {
+        b = b->next;
+        if (b) b->used = 0;
+    }
+    if (!b) {
+        size_t cap = size > ARENA_BLOCK_MIN ? size : ARENA_BLOCK_MIN;
+        b = malloc(sizeof(ArenaBlock) + cap);
+        if (!b) { fputs("Out of memory\n", stderr); exit(1); }
+        b->cap = cap; b->used = 0; b->next = NULL;
+        if (!a->first) a->first = b;
+        else { ArenaBlock *t = a->cur; while (t->next) t = t->next; t->next = b; }
+    }
+    a->cur = b;
+    void *p = b->data + b->used;
+    b->used += size;
+    return p;
+}
+
+ArenaMark arena_mark(Arena *a) {
+    ArenaMark m = { a->cur, a->cur ? a->cur->used : 0 };
+    return m;
+}
+
+void arena_release(Arena *a, ArenaMark m) {
+    if (m.block) { a->cur = m.block; a->cur->used = m.used; }
+    else { a->cur = a->first; if (a->cur) a->cur->used = 0; }
+}
+
+void arena_reset(Arena *a) {
+    a->cur = a->first;
+    if (a->cur) a->cur->used = 0;
+}
+
+void arena_free(Arena *a) {
+    ArenaBlock *b = a->first;
+    while (b) { ArenaBlock *n = b->next; free(b); b = n; }
+    a->first = a->cur = NULL;
+}
+
+// -------------------- Arbitrary-precision integers --------------------
+// Sign-magnitude, little-endian 32-bit limbs, always trimmed (zero has n == 0).
+// mag_* helpers work on raw limb arrays; big_* wrap them with signs.
+#define KARATSUBA_THRESHOLD 32   // limbs; below this schoolbook wins
+#define BZ_THRESHOLD        64   // limbs; below this Knuth division wins
+#define BIG_MAX_BITS        (1LL << 31)
+
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+
+typedef struct {
+    limb_t *d;
+    int n;
+    int neg;
+} Big;
+
+static Arena *big_arena; // arena used for all bignum storage of the current line
+
+static limb_t *limbs_alloc(int n) {
+    return arena_alloc(big_arena, (size_t)(n > 0 ? n : 1) * sizeof(limb_t));
+}
+
+static int mag_trim(const limb_t *a, int n) {
+    while (n > 0 && a[n-1] == 0) n--;
+    return n;
+}
+
+static int mag_cmp(const limb_t *a, int an, const limb_t *b, int bn) {
+    an = mag_trim(a, an); bn = mag_trim(b, bn);
+    if (an != bn) return an < bn ? -1 : 1;
+    for (int i = an - 1; i >= 0; --i)
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+// r[0..rn) += b[0..bn), rn >= bn; returns the carry out of r[rn-1].
+static limb_t mag_add_into(limb_t *r, int rn, const limb_t *b, int bn) {
+    dlimb_t c = 0;
+    int i = 0;
+    for (; i < bn; ++i) { c += (dlimb_t)r[i] + b[i]; r[i] = (limb_t)c; c >>= 32; }
+    for (; c && i < rn; ++i) { c += r[i]; r[i] = (limb_t)c; c >>= 32; }
+    return (limb_t)c;
+}
+
+// r[0..rn) -= b[0..bn), rn >= bn; returns the borrow out of r[rn-1].
+static limb_t mag_sub_into(limb_t *r, int rn, const limb_t *b, int bn) {
+    int64_t br = 0;
+    int i = 0;
+    for (; i < bn; ++i) { int64_t t = (int64_t)r[i] - b[i] - br; r[i] = (limb_t)t; br = t < 0; }
+    for (; br && i < rn; ++i) { int64_t t = (int64_t)r[i] - br; r[i] = (limb_t)t; br = t < 0; }
+    return (limb_t)br;
+}
+
+// Shift left by bits (< 32) into r (an + 1 limbs); r may alias a.
+static void mag_shl_bits(const limb_t *a, int an, int bits, limb_t *r) {
+    limb_t carry = 0;
+    for (int i = 0; i < an; ++i) {
+        limb_t v = a[i];
+        r[i] = bits ? (v << bits) | carry : v;
+        carry = bits ? v >> (32 - bits) : 0;
+    }
+    r[an] = carry;
+}
+
+// Shift right by bits (< 32) in place.
+static void mag_shr_bits(limb_t *a, int an, int bits) {
+    if (!bits) return;
+    for (int i = 0; i < an; ++i)
+        a[i] = (a[i] >> bits) | (i + 1 < an ? a[i+1] << (32 - bits) : 0);
+}
+
+// -------------------- NTT multiplication --------------------
+// Number-theoretic transform over the prime p = 2^64 - 2^32 + 1, whose
+// multiplicative group has order divisible by 2^32. Limbs are split into
+// 16-bit digits so every convolution coefficient (< n * 2^32) stays below p.
+// Butterflies of each stage are spread across num_threads.
+#define NTT_P          0xFFFFFFFF00000001ULL
+#define NTT_GENERATOR  7ULL
+#define NTT_THRESHOLD  4096      // limbs; below this Karatsuba wins
+#define NTT_PAR_MIN    (1 << 14) // butterflies per thread worth spawning for
+
+static inline uint64_t ntt_add(uint64_t a, uint64_t b) {
+    uint64_t s = a + b;
+    if (s < a || s >= NTT_P) s -= NTT_P;
+    return s;
+}
+
+static inline uint64_t ntt_sub(uint64_t a, uint64_t b) {
+    return a >= b ? a - b : a - b + NTT_P;
+}
+
+// Reduce a 128-bit product using 2^64 = 2^32 - 1 and 2^96 = -1 (mod p).
+static inline uint64_t ntt_mul(uint64_t a, uint64_t b) {
+    unsigned __int128 x = (unsigned __int128)a * b;
+    uint64_t lo = (uint64_t)x, hi = (uint64_t)(x >> 64);
+    uint64_t hi_hi = hi >> 32, hi_lo = hi & 0xFFFFFFFFu;
+    uint64_t t0 = lo - hi_hi;
+    if (lo < hi_hi) t0 -= 0xFFFFFFFFu;
+    uint64_t t1 = hi_lo * 0xFFFFFFFFu;
+    uint64_t t2 = t0 + t1;
+    if (t2 < t1) t2 += 0xFFFFFFFFu;
+    return t2 >= NTT_P ? t2 - NTT_P : t2;
+}
+
+static uint64_t ntt_pow(uint64_t b, uint64_t e) {
+    uint64_t r = 1;
+    for (; e; e >>= 1, b = ntt_mul(b, b))
+        if (e & 1) r = ntt_mul(r, b);
+    return r;
+}
+
+// Twiddles are laid out per stage: tw[half + j] = (root of order 2*half)^j,
+// so every stage reads its factors contiguously.
+typedef struct {
+    uint64_t *a;
+    const uint64_t *tw;
+    size_t half;
+} NttStage;
+
+static void ntt_stage_range(void *ctx, size_t begin, size_t end) {
+    const NttStage *s = ctx;
+    size_t blk = begin / s->half, j = begin % s->half;
+    for (size_t k = begin; k < end; ++blk, j = 0) {
+        uint64_t *x = s->a + blk * 2 * s->half, *y = x + s->half;
+        const uint64_t *tw = s->tw + s->half;
+        for (; j < s->half && k < end; ++j, ++k) {
+            uint64_t v = ntt_mul(y[j], tw[j]);
+            y[j] = ntt_sub(x[j], v);
+            x[j] = ntt_add(x[j], v);
+        }
+    }
+}
+
+typedef struct {
+    uint64_t *a;
+    const uint64_t *b;
+    uint64_t scale;
+} NttPointwise;
+
+static void ntt_pointwise_range(void *ctx, size_t begin, size_t end) {
+    const NttPointwise *p = ctx;
+    for (size_t i = begin; i < end; ++i) {
+        uint64_t v = p->b ? ntt_mul(p->a[i], p->b[i]) : p->a[i];
+        p->a[i] = p->scale != 1 ? ntt_mul(v, p->scale) : v;
+    }
+}
+
+static void ntt_transform(uint64_t *a, size_t n, const uint64_t *tw) {
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) { uint64_t t = a[i]; a[i] = a[j]; a[j] = t; }
+    }
+    for (size_t half = 1; half < n; half <<= 1) {
+        NttStage s = { a, tw, half };
+        parallel_for(n / 2, NTT_PAR_MIN, ntt_stage_range, &s);
+    }
+}
+
+static void ntt_twiddles(uint64_t *tw, size_t n, uint64_t w) {
+    uint64_t *top = tw + n / 2;
+    top[0] = 1;
+    for (size_t j = 1; j < n / 2; ++j) top[j] = ntt_mul(top[j-1], w);
+    for (size_t half = n / 4; half >= 1; half >>= 1)
+        for (size_t j = 0; j < half; ++j) tw[half + j] = tw[2 * half + 2 * j];
+}
+
+static void ntt_load(uint64_t *dst, size_t n, const limb_t *a, int an) {
+    for (int i = 0; i < an; ++i) {
+        dst[2*i] = a[i] & 0xFFFFu;
+        dst[2*i + 1] = a[i] >> 16;
+    }
+    memset(dst + 2 * (size_t)an, 0, (n - 2 * (size_t)an) * sizeof(uint64_t));
+}
+
+// r (an + bn limbs) = a * b via forward transforms, pointwise product and an
+// inverse transform; squaring transforms once.
+static void mag_mul_ntt(const limb_t *a, int an, const limb_t *b, int bn, limb_t *r) {
+    size_t digits = 2 * ((size_t)an + (size_t)bn), n = 1;
+    while (n < digits) n <<= 1;
+
+    ArenaMark mark = arena_mark(big_arena);
+    uint64_t *fa = arena_alloc(big_arena, n * sizeof(uint64_t));
+    uint64_t *tw = arena_alloc(big_arena, n * sizeof(uint64_t));
+    int square = (a == b && an == bn);
+    uint64_t *fb = square ? fa : arena_alloc(big_arena, n * sizeof(uint64_t));
+
+    uint64_t w = ntt_pow(NTT_GENERATOR, (NTT_P - 1) / n);
+    ntt_twiddles(tw, n, w);
+
+    ntt_load(fa, n, a, an);
+    ntt_transform(fa, n, tw);
+    if (!square) {
+        ntt_load(fb, n, b, bn);
+        ntt_transform(fb, n, tw);
+    }
+    NttPointwise pw = { fa, fb, 1 };
+    parallel_for(n, NTT_PAR_MIN, ntt_pointwise_range, &pw);
+
+    // Inverse transform: same butterflies with w^-1, then scale by 1/n
+    ntt_twiddles(tw, n, ntt_pow(w, n - 1));
+    ntt_transform(fa, n, tw);
+    NttPointwise sc = { fa, NULL, ntt_pow(n % NTT_P, NTT_P - 2) };
+    parallel_for(n, NTT_PAR_MIN, ntt_pointwise_range, &sc);
+
+    // Carry-propagate 16-bit digits back into 32-bit limbs
+    unsigned __int128 carry = 0;
+    for (int i = 0; i < an + bn; ++i) {
+        carry += fa[2*i];
+        uint32_t lo = (uint32_t)(carry & 0xFFFFu);
+        carry >>= 16;
+        carry += fa[2*i + 1];
+        r[i] = lo | (uint32_t)((carry & 0xFFFFu) << 16);
+        carry >>= 16;
+    }
+    arena_release(big_arena, mark);
+}
+
+static void mag_mul_school(const limb_t *a, int an, const limb_t *b, int bn, limb_t *r) {
+    memset(r, 0, (size_t)(an + bn) * sizeof(limb_t));
+    for (int i = 0; i < bn; ++i) {
+        dlimb_t c = 0, bi = b[i];
+        if (!bi) continue;
+        for (int j = 0; j < an; ++j) {
+            c += (dlimb_t)a[j] * bi + r[i+j];
+            r[i+j] = (limb_t)c;
+            c >>= 32;
+        }
+        r[i+an] = (limb_t)c;
+    }
+}
+
+// r (an + bn limbs, untrimmed) = a * b. r must not alias a or b.
+static void mag_mul(const limb_t *a, int an, const limb_t *b, int bn, limb_t *r) {
+    if (an < bn) { const limb_t *t = a; a = b; b = t; int tn = an; an = bn; bn = tn; }
+    if (bn == 0) { memset(r, 0, (size_t)an * sizeof(limb_t)); return; }
+    if (bn < KARATSUBA_THRESHOLD) { mag_mul_school(a, an, b, bn, r); return; }
+    if (bn >= NTT_THRESHOLD) { mag_mul_ntt(a, an, b, bn, r); return; }
+
+    ArenaMark mark = arena_mark(big_arena);
+    if (2 * bn <= an) {
+        // Unbalanced: multiply b by bn-sized slices of a
+        limb_t *tmp = limbs_alloc(2 * bn);
+        memset(r, 0, (size_t)(an + bn) * sizeof(limb_t));
+        for (int i = 0; i < an; i += bn) {
+            int cn = an - i < bn ? an - i : bn;
+            mag_mul(a + i, cn, b, bn, tmp);
+            mag_add_into(r + i, an + bn - i, tmp, cn + bn);
+        }
+        arena_release(big_arena, mark);
+        return;
+    }
+
+    // Karatsuba: a = a1*B^h + a0, b = b1*B^h + b0
+    int h = (an + 1) / 2;
+    int a1n = an - h, b1n = bn - h;
+    mag_mul(a, h, b, h, r);                               // z0 -> r[0 .. 2h)
+    if (b1n > 0) mag_mul(a + h, a1n, b + h, b1n, r + 2*h); // z2 -> r[2h .. an+bn)
+    else memset(r + 2*h, 0, (size_t)a1n * sizeof(limb_t));
+
+    limb_t *sa = limbs_alloc(h + 1), *sb = limbs_alloc(h + 1);
+    memcpy(sa, a, (size_t)h * sizeof(limb_t)); sa[h] = mag_add_into(sa, h, a + h, a1n);
+    memcpy(sb, b, (size_t)h * sizeof(limb_t)); sb[h] = mag_add_into(sb, h, b + h, b1n);
+    int san = mag_trim(sa, h + 1), sbn = mag_trim(sb, h + 1);
+
+    limb_t *z1 = limbs_alloc(san + sbn);
+    mag_mul(sa, san, sb, sbn, z1);
+    int z1n = san + sbn;
+    mag_sub_into(z1, z1n, r, mag_trim(r, 2*h));
+    mag_sub_into(z1, z1n, r + 2*h, mag_trim(r + 2*h, a1n + b1n));
+    mag_add_into(r + h, an + bn - h, z1, mag_trim(z1, z1n));
+    arena_release(big_arena, mark);
+}
+
+// Knuth algorithm D. u has m limbs, v has n limbs (v[n-1] != 0, m >= n).
+// q receives m-n+1 limbs, r receives n limbs.
+static void mag_divmod_knuth(const limb_t *u, int m, const limb_t *v, int n, limb_t *q, limb_t *r) {
+    if (n == 1) {
+        dlimb_t k = 0;
+        for (int j = m - 1; j >= 0; --j) {
+            dlimb_t cur = (k << 32) | u[j];
+            q[j] = (limb_t)(cur / v[0]);
+            k = cur % v[0];
+        }
+        r[0] = (limb_t)k;
+        return;
+    }
+
+    ArenaMark mark = arena_mark(big_arena);
+    int s = __builtin_clz(v[n-1]);
+    limb_t *vn = limbs_alloc(n + 1), *un = limbs_alloc(m + 1);
+    mag_shl_bits(v, n, s, vn);
+    mag_shl_bits(u, m, s, un);
+
+    for (int j = m - n; j >= 0; --j) {
+        dlimb_t num = ((dlimb_t)un[j+n] << 32) | un[j+n-1];
+        dlimb_t qhat = num / vn[n-1], rhat = num % vn[n-1];
+        while (qhat >> 32 || qhat * vn[n-2] > ((rhat << 32) | un[j+n-2])) {
+            qhat--; rhat += vn[n-1];
+            if (rhat >> 32) break;
+        }
+        int64_t t; dlimb_t k = 0;
+        for (int i = 0; i < n; ++i) {
+            dlimb_t p = qhat * vn[i];
+            t = (int64_t)un[i+j] - (int64_t)k - (int64_t)(p & 0xFFFFFFFFu);
+            un[i+j] = (limb_t)t;
+            k = (p >> 32) - (dlimb_t)(t >> 32);
+        }
+        t = (int64_t)un[j+n] - (int64_t)k;
+        un[j+n] = (limb_t)t;
+        q[j] = (limb_t)qhat;
+        if (t < 0) {
+            q[j]--;
+            un[j+n] += mag_add_into(un + j, n, vn, n);
+        }
+    }
+    mag_shr_bits(un, n, s);
+    memcpy(r, un, (size_t)n * sizeof(limb_t));
+    arena_release(big_arena, mark);
+}
+
+// Burnikel-Ziegler recursive division. b has n limbs with its top bit set,
+// a has 2n limbs and a < b * B^n; q and r receive n limbs each.
+static void bz_div3h2h(const limb_t *a, const limb_t *b, int h, limb_t *q, limb_t *r);
+
+static void bz_div2n1n(const limb_t *a, const limb_t *b, int n, limb_t *q, limb_t *r) {
+    if ((n & 1) || n < BZ_THRESHOLD) {
+        int an = mag_trim(a, 2*n);
+        memset(q, 0, (size_t)n * sizeof(limb_t));
+        if (an < n) {
+            memcpy(r, a, (size_t)n * sizeof(limb_t));
+            return;
+        }
+        ArenaMark mark = arena_mark(big_arena);
+        limb_t *qt = limbs_alloc(an - n + 1);
+        mag_divmod_knuth(a, an, b, n, qt, r);
+        memcpy(q, qt, (size_t)mag_trim(qt, an - n + 1) * sizeof(limb_t));
+        arena_release(big_arena, mark);
+        return;
+    }
+
+    int h = n / 2;
+    ArenaMark mark = arena_mark(big_arena);
+    limb_t *t = limbs_alloc(3*h);
+    bz_div3h2h(a + h, b, h, q + h, t + h);   // [A1 A2 A3] / B -> Q1, R
+    memcpy(t, a, (size_t)h * sizeof(limb_t)); // [R A4]
+    bz_div3h2h(t, b, h, q, r);                // -> Q2, S
+    arena_release(big_arena, mark);
+}
+
+// a has 3h limbs, b has 2h limbs (top bit set), a < b * B^h.
+static void bz_div3h2h(const limb_t *a, const limb_t *b, int h, limb_t *q, limb_t *r) {
+    const limb_t *a1 = a + 2*h, *b1 = b + h;
+    ArenaMark mark = arena_mark(big_arena);
+    limb_t *rh = limbs_alloc(2*h + 1);       // [R1 A3], R1 may need h+1 limbs
+    memcpy(rh, a, (size_t)h * sizeof(limb_t));
+
+    if (mag_cmp(a1, h, b1, h) < 0) {
+        bz_div2n1n(a + h, b1, h, q, rh + h);
+        rh[2*h] = 0;
+    } else {
+        // q = B^h - 1 and A1 == B1, so R1 = A2 + B1
+        for (int i = 0; i < h; ++i) q[i] = 0xFFFFFFFFu;
+        memcpy(rh + h, a + h, (size_t)h * sizeof(limb_t));
+        rh[2*h] = mag_add_into(rh + h, h, b1, h);
+    }
+
+    limb_t *d = limbs_alloc(2*h);
+    mag_mul(q, h, b, h, d);                   // D = Q * B2
+    while (mag_cmp(rh, 2*h + 1, d, 2*h) < 0) {
+        mag_add_into(rh, 2*h + 1, b, 2*h);
+        for (int i = 0; i < h && q[i]-- == 0; ++i) {}
+    }
+    mag_sub_into(rh, 2*h + 1, d, 2*h);
+    memcpy(r, rh, (size_t)(2*h) * sizeof(limb_t));
+    arena_release(big_arena, mark);
+}
+
+// u (m limbs) / v (n limbs, trimmed, n >= 1, m >= n): q gets m-n+1 limbs, r gets n limbs.
+static void mag_divmod(const limb_t *u, int m, const limb_t *v, int n, limb_t *q, limb_t *r) {
+    if (n < BZ_THRESHOLD || m - n < BZ_THRESHOLD) { mag_divmod_knuth(u, m, v, n, q, r); return; }
+
+    ArenaMark mark = arena_mark(big_arena);
+    // Block size N = j * 2^k >= n with j < BZ_THRESHOLD, so the recursion bottoms out evenly
+    int k = 0;
+    while ((n >> k) >= BZ_THRESHOLD) k++;
+    int N = ((n + (1 << k) - 1) >> k) << k;
+    int ls = N - n, bs = __builtin_clz(v[n-1]);
+
+    limb_t *bb = limbs_alloc(N + 1);
+    memset(bb, 0, (size_t)ls * sizeof(limb_t));
+    mag_shl_bits(v, n, bs, bb + ls);
+
+    int an = m + ls + 1;
+    int t = (an + 1 + N - 1) / N;
+    if (t < 2) t = 2;
+    limb_t *aa = limbs_alloc(t * N);
+    memset(aa, 0, (size_t)(t * N) * sizeof(limb_t));
+    mag_shl_bits(u, m, bs, aa + ls);
+
+    limb_t *z = limbs_alloc(2 * N), *qq = limbs_alloc((t - 1) * N), *rr = limbs_alloc(N);
+    memcpy(z, aa + (t - 2) * N, (size_t)(2 * N) * sizeof(limb_t));
+    for (int i = t - 2; i >= 0; --i) {
+        bz_div2n1n(z, bb, N, qq + i * N, rr);
+        if (i > 0) {
+            memcpy(z + N, rr, (size_t)N * sizeof(limb_t));
+            memcpy(z, aa + (i - 1) * N, (size_t)N * sizeof(limb_t));
+        }
+    }
+    mag_shr_bits(rr, N, bs);
+    memcpy(r, rr + ls, (size_t)n * sizeof(limb_t));
+    memset(q, 0, (size_t)(m - n + 1) * sizeof(limb_t));
+    int qn = mag_trim(qq, (t - 1) * N);
+    memcpy(q, qq, (size_t)qn * sizeof(limb_t));
+    arena_release(big_arena, mark);
+}
+
+// ---- signed layer ----
+static Big big_make(limb_t *d, int n, int neg) {
+    Big b;
+    b.d = d; b.n = mag_trim(d, n); b.neg = b.n ? neg : 0;
+    return b;
+}
+
+Big big_from_ll(long long v) {
+    unsigned long long m = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    limb_t *d = limbs_alloc(2);
+    d[0] = (limb_t)m; d[1] = (limb_t)(m >> 32);
+    return big_make(d, 2, v < 0);
+}
+
+long long big_bits(const Big *a) {
+    return a->n ? 32LL * (a->n - 1) + (32 - __builtin_clz(a->d[a->n-1])) : 0;
+}
+
+// 1 if a fits in an unsigned long long magnitude (stored to *out).
+int big_to_u64(const Big *a, unsigned long long *out) {
+    if (a->n > 2) return 0;
+    *out = a->n == 0 ? 0 : a->n == 1 ? a->d[0] : ((unsigned long long)a->d[1] << 32) | a->d[0];
+    return 1;
+}
+
+Big big_neg(Big a) { if (a.n) a.neg = !a.neg; return a; }
+
+static Big big_add_mag(const Big *a, const Big *b, int neg) {
+    const Big *x = a->n >= b->n ? a : b, *y = a->n >= b->n ? b : a;
+    limb_t *d = limbs_alloc(x->n + 1);
+    memcpy(d, x->d, (size_t)x->n * sizeof(limb_t));
+    d[x->n] = mag_add_into(d, x->n, y->d, y->n);
+    return big_make(d, x->n + 1, neg);
+}
+
+static Big big_sub_mag(const Big *a, const Big *b, int neg) {
+    // |a| - |b| with the sign of a (flipped if |a| < |b|)
+    int c = mag_cmp(a->d, a->n, b->d, b->n);
+    if (c < 0) { const Big *t = a; a = b; b = t; neg = !neg; }
+    limb_t *d = limbs_alloc(a->n);
+    memcpy(d, a->d, (size_t)a->n * sizeof(limb_t));
+    mag_sub_into(d, a->n, b->d, b->n);
+    return big_make(d, a->n, neg);
+}
+
+Big big_add(Big a, Big b) {
+    return a.neg == b.neg ? big_add_mag(&a, &b, a.neg) : big_sub_mag(&a, &b, a.neg);
+}
+
+Big big_sub(Big a, Big b) { return big_add(a, big_neg(b)); }
+
+Big big_mul(Big a, Big b) {
+    if (!a.n || !b.n) return big_make(NULL, 0, 0);
+    limb_t *d = limbs_alloc(a.n + b.n);
+    mag_mul(a.d, a.n, b.d, b.n, d);
+    return big_make(d, a.n + b.n, a.neg != b.neg);
+}
+
+// Truncating division (C semantics); b must be non-zero.
+void big_divmod(Big a, Big b, Big *q, Big *r) {
+    if (mag_cmp(a.d, a.n, b.d, b.n) < 0) {
+        if (q) *q = big_make(NULL, 0, 0);
+        if (r) *r = a;
+        return;
+    }
+    limb_t *qd = limbs_alloc(a.n - b.n + 1), *rd = limbs_alloc(b.n);
+    mag_divmod(a.d, a.n, b.d, b.n, qd, rd);
+    if (q) *q = big_make(qd, a.n - b.n + 1, a.neg != b.neg);
+    if (r) *r = big_make(rd, b.n, a.neg);
+}
+
+// base^exp by left-to-right square-and-multiply; 0 if the result would exceed BIG_MAX_BITS.
+int big_pow(Big base, unsigned long long exp, Big *out) {
+    if (exp == 0) { *out = big_from_ll(1); return 1; }
+    if (base.n == 0) { *out = base; return 1; }
+    if (base.n == 1 && base.d[0] == 1) { *out = big_from_ll(base.neg && (exp & 1) ? -1 : 1); return 1; }
+    if ((double)(big_bits(&base) - 1) * (double)exp > (double)BIG_MAX_BITS) return 0;
+
+    Big r = base;
+    int top = 63 - __builtin_clzll(exp);
+    for (int i = top - 1; i >= 0; --i) {
+        r = big_mul(r, r);
+        if ((exp >> i) & 1) r = big_mul(r, base);
+    }
+    *out = r;
+    return 1;
+}
+
+// -------------------- Decimal conversion --------------------
+// Short numbers use the quadratic nine-digits-per-limb loops. Longer ones are
+// split recursively around cached powers 10^(9*2^k), so conversion costs a few
+// multiplications/divisions of the subquadratic kind above.
+#define DEC_BASECASE_DIGITS 1200
+#define DEC_POW_MAX         40
+
+static Arena radix_arena;                 // powers of ten outlive the per-line arena
+static Big dec_pow_cache[DEC_POW_MAX];    // 10^(9 * 2^k)
+static int dec_pow_count = 0;
+
+static const Big *dec_pow(int k) {
+    while (dec_pow_count <= k) {
+        Arena *line_arena = big_arena;
+        big_arena = &radix_arena;
+        dec_pow_cache[dec_pow_count] = dec_pow_count == 0
+            ? big_from_ll(1000000000LL)
+            : big_mul(dec_pow_cache[dec_pow_count - 1], dec_pow_cache[dec_pow_count - 1]);
+        big_arena = line_arena;
+        dec_pow_count++;
+    }
+    return &dec_pow_cache[k];
+}
+
+static Big dec_parse_basecase(const char *s, int len) {
+    limb_t *d = limbs_alloc(len / 9 + 2);
+    int n = 0;
+    for (int i = 0; i < len; ) {
+        int chunk = (len - i) % 9 ? (len - i) % 9 : 9;
+        limb_t v = 0, mul = 1;
+        for (int k = 0; k < chunk; ++k, ++i) { v = v * 10 + (limb_t)(s[i] - '0'); mul *= 10; }
+        dlimb_t c = v;
+        for (int k = 0; k < n; ++k) { c += (dlimb_t)d[k] * mul; d[k] = (limb_t)c; c >>= 32; }
+        if (c) d[n++] = (limb_t)c;
+    }
+    return big_make(d, n, 0);
+}
+
+// Decimal digits -> Big: value = high * 10^(9*2^k) + low.
+Big big_from_dec(const char *s, int len) {
+    if (len <= DEC_BASECASE_DIGITS) return dec_parse_basecase(s, len);
+    int k = 0;
+    while (9LL << (k + 1) < len) k++;
+    int low_len = 9 << k;
+    Big high = big_from_dec(s, len - low_len);
+    Big low = big_from_dec(s + len - low_len, low_len);
+    return big_add(big_mul(high, *dec_pow(k)), low);
+}
+
+// Writes exactly width digits of a (0 <= a < 10^width), zero-padded on the left.
+static void dec_write_basecase(Big a, char *out, size_t width) {
+    memset(out, '0', width);
+    if (!a.n) return;
+    ArenaMark mark = arena_mark(big_arena);
+    limb_t *t = limbs_alloc(a.n);
+    memcpy(t, a.d, (size_t)a.n * sizeof(limb_t));
+    int n = a.n;
+    char *p = out + width;
+    while (n && p > out) {
+        dlimb_t k = 0;
+        for (int j = n - 1; j >= 0; --j) {
+            dlimb_t cur = (k << 32) | t[j];
+            t[j] = (limb_t)(cur / 1000000000u);
+            k = cur % 1000000000u;
+        }
+        for (int i = 0; i < 9 && p > out; ++i) { *--p = (char)('0' + k % 10); k /= 10; }
+        n = mag_trim(t, n);
+    }
+    arena_release(big_arena, mark);
+}
+
+static void dec_write(Big a, char *out, size_t width) {
+    if (width <= DEC_BASECASE_DIGITS || a.n == 0) { dec_write_basecase(a, out, width); return; }
+    int k = 0;
+    while ((9ULL << (k + 1)) <= width / 2) k++;
+    size_t low_width = 9ULL << k;
+    ArenaMark mark = arena_mark(big_arena);
+    Big q, r;
+    big_divmod(a, *dec_pow(k), &q, &r);
+    dec_write(q, out, width - low_width);
+    dec_write(r, out + width - low_width, low_width);
+    arena_release(big_arena, mark);
+}
+
+// Big -> NUL-terminated decimal string in the arena.
+char *big_to_dec(Big a) {
+    size_t width = (size_t)(big_bits(&a) * 30103 / 100000) + 1; // >= digit count
+    char *out = arena_alloc(big_arena, width + 2);
+    char *p = out;
+    if (a.neg) { *p++ = '-'; a.neg = 0; }
+    dec_write(a, p, width);
+    size_t lead = 0;
+    while (lead + 1 < width && p[lead] == '0') lead++;
+    memmove(p, p + lead, width - lead);
+    p[width - lead] = '\0';
+    return out;
+}
+
+// -------------------- Exact evaluation (small/big hybrid values) --------------------
+// A Num is a plain long long until an overflow check fires; only then is it
+// promoted to an arena Big, and results that fit again are demoted.
+typedef struct {
+    long long small;
+    Big *big;         // NULL while the value fits in small
+} Num;
+
+static inline Num num_small(long long v) { Num n = { v, NULL }; return n; }
+
+static Big num_to_big(Num n) { return n.big ? *n.big : big_from_ll(n.small); }
+
+// Demote when the magnitude fits in a long long.
+static Num num_from_big(Big b) {
+    unsigned long long m;
+    if (big_to_u64(&b, &m) && (m <= (unsigned long long)LLONG_MAX || (b.neg && m == 1ULL << 63)))
+        return num_small(b.neg ? (long long)(0ULL - m) : (long long)m);
+    Num n = { 0, arena_alloc(big_arena, sizeof(Big)) };
+    *n.big = b;
+    return n;
+}
+
+static Num num_from_dec(const char *s, int len) {
+    if (len <= 18) {
+        long long v = 0;
+        for (int i = 0; i < len; ++i) v = v * 10 + (s[i] - '0');
+        return num_small(v);
+    }
+    return num_from_big(big_from_dec(s, len));
+}
+
+static char *num_to_dec(Num n) {
+    if (n.big) return big_to_dec(*n.big);
+    char *out = arena_alloc(big_arena, 24);
+    sprintf(out, "%lld", n.small);
+    return out;
+}
+
+static Num num_neg(Num a) {
+    if (!a.big && a.small != LLONG_MIN) { a.small = -a.small; return a; }
+    return num_from_big(big_neg(num_to_big(a)));
+}
+
+// A big value never fits in a long long, so it is never zero.
+static inline int num_is_zero(Num a) { return !a.big && a.small == 0; }
+
+// -1, 0 or 1 as a < b, a == b or a > b.
+static int num_cmp(Num a, Num b) {
+    if (!a.big && !b.big) return (a.small > b.small) - (a.small < b.small);
+    Big x = num_to_big(a), y = num_to_big(b);
+    if (x.neg != y.neg) return x.neg ? -1 : 1;
+    int c = mag_cmp(x.d, x.n, y.d, y.n);
+    return x.neg ? -c : c;
+}
+
+// r = a op b for the arithmetic operators; 0 with err_msg set on failure.
+static int num_binop(char op, Num a, Num b, Num *r, char *err_msg) {
+    long long s;
+
+    // Fast path: both small and no overflow
+    if (!a.big && !b.big) {
+        int ok = 0;
+        switch (op) {
+            case '+': ok = !__builtin_add_overflow(a.small, b.small, &s); break;
+            case '-': ok = !__builtin_sub_overflow(a.small, b.small, &s); break;
+            case '*': ok = !__builtin_mul_overflow(a.small, b.small, &s); break;
+            case '/':
+                if (b.small == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+                if ((ok = !(a.small == LLONG_MIN && b.small == -1))) s = a.small / b.small;
+                break;
+            case '%':
+                if (b.small == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+                ok = 1; s = (b.small == -1) ? 0 : a.small % b.small;
+                break;
+            case '^':
+                if (b.small < 0) { strcpy(err_msg,"Invalid or overflow in exponentiation"); return 0; }
+                ok = safe_pow_ll(a.small, b.small, &s);
+                break;
+            default:
+                strcpy(err_msg,"Unknown operator in evaluation");
+                return 0;
+        }
+        if (ok) { *r = num_small(s); return 1; }
+    }
+
+    // Slow path: promote, compute exactly, demote
+    Big x = num_to_big(a), y = num_to_big(b), z;
+    unsigned long long e;
+    switch (op) {
+        case '+': z = big_add(x, y); break;
+        case '-': z = big_sub(x, y); break;
+        case '*': z = big_mul(x, y); break;
+        case '/':
+            if (!y.n) { strcpy(err_msg,"Division by zero"); return 0; }
+            big_divmod(x, y, &z, NULL); break;
+        case '%':
+            if (!y.n) { strcpy(err_msg,"Modulo by zero"); return 0; }
+            big_divmod(x, y, NULL, &z); break;
+        case '^':
+            if (y.neg || !big_to_u64(&y, &e) || !big_pow(x, e, &z)) {
+                strcpy(err_msg,"Invalid or overflow in exponentiation");
+                return 0;
+            }
+            break;
+        default:
+            strcpy(err_msg,"Unknown operator in evaluation");
+            return 0;
+    }
+    *r = num_from_big(z);
+    return 1;
+}
+
+static inline int exact_literal(const Token *t, Num *out, char *err_msg) {
+    if (t->decimal) { strcpy(err_msg,"Decimal literals need --fixed or --double"); return 0; }
+    *out = num_from_dec(t->text, t->len);
+    return 1;
+}
+
+static inline int exact_negate(Num *v, char *err_msg) {
+    (void)err_msg;
+    *v = num_neg(*v);
+    return 1;
+}
+
+static inline int exact_binary(char op, Num a, Num b, Num *out, char *err_msg) {
+    if (is_comparison(op)) { *out = num_small(comparison_holds(op, num_cmp(a, b))); return 1; }
+    if (op == '&') { *out = num_small(!num_is_zero(a) && !num_is_zero(b)); return 1; }
+    if (op == '|') { *out = num_small(!num_is_zero(a) || !num_is_zero(b)); return 1; }
+    return num_binop(op, a, b, out, err_msg);
+}
+
+// Callers point big_arena at the arena that should own the results.
+DEFINE_ENGINE(exact, Num, ExactStack)
+
+// -------------------- Rational evaluation --------------------
+// Values are num/den pairs with den > 0. Reduction by the binary GCD is
+// deferred until a result is printed or a component outgrows a long long, so
+// chains of small +, -, * never pay for a GCD.
+typedef struct {
+    Num num, den;
+} Rat;
+
+static int num_sign(Num a) {
+    if (a.big) return a.big->neg ? -1 : 1;
+    return (a.small > 0) - (a.small < 0);
+}
+
+static Num num_from_u64(unsigned long long m) {
+    if (m <= (unsigned long long)LLONG_MAX) return num_small((long long)m);
+    limb_t *d = limbs_alloc(2);
+    d[0] = (limb_t)m; d[1] = (limb_t)(m >> 32);
+    return num_from_big(big_make(d, 2, 0));
+}
+
+static unsigned long long num_mag_u64(Num a) {
+    return a.small < 0 ? 0ULL - (unsigned long long)a.small : (unsigned long long)a.small;
+}
+
+// Stein's binary GCD
+static unsigned long long gcd_u64(unsigned long long a, unsigned long long b) {
+    if (!a) return b;
+    if (!b) return a;
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    do {
+        b >>= __builtin_ctzll(b);
+        if (a > b) { unsigned long long t = a; a = b; b = t; }
+        b -= a;
+    } while (b);
+    return a << shift;
+}
+
+static long long mag_ctz(const limb_t *a, int n) {
+    for (int i = 0; i < n; ++i)
+        if (a[i]) return 32LL * i + __builtin_ctz(a[i]);
+    return 0;
+}
+
+// In-place right shift by any number of bits; returns the trimmed length.
+static int mag_shr_any(limb_t *a, int n, long long bits) {
+    int limbs = (int)(bits / 32);
+    if (limbs >= n) return 0;
+    if (limbs) memmove(a, a + limbs, (size_t)(n - limbs) * sizeof(limb_t));
+    mag_shr_bits(a, n - limbs, (int)(bits % 32));
+    return mag_trim(a, n - limbs);
+}
+
+static Big big_gcd(Big a, Big b) {
+    if (!a.n) { b.neg = 0; return b; }
+    if (!b.n) { a.neg = 0; return a; }
+    limb_t *x = limbs_alloc(a.n), *y = limbs_alloc(b.n);
+    memcpy(x, a.d, (size_t)a.n * sizeof(limb_t));
+    memcpy(y, b.d, (size_t)b.n * sizeof(limb_t));
+    int xn = a.n, yn = b.n;
+    long long za = mag_ctz(x, xn), zb = mag_ctz(y, yn), shift = za < zb ? za : zb;
+
+    xn = mag_shr_any(x, xn, za);
+    while (yn) {
+        yn = mag_shr_any(y, yn, mag_ctz(y, yn));
+        if (mag_cmp(x, xn, y, yn) > 0) { limb_t *t = x; x = y; y = t; int tn = xn; xn = yn; yn = tn; }
+        mag_sub_into(y, yn, x, xn);
+        yn = mag_trim(y, yn);
+    }
+    int ls = (int)(shift / 32);
+    limb_t *r = limbs_alloc(xn + ls + 1);
+    memset(r, 0, (size_t)ls * sizeof(limb_t));
+    mag_shl_bits(x, xn, (int)(shift % 32), r + ls);
+    return big_make(r, xn + ls + 1, 0);
+}
+
+static Num num_gcd(Num a, Num b) {
+    if (a.big && !b.big) { Num t = a; a = b; b = t; }
+    if (!a.big && b.big && a.small != 0) {
+        char err[128];
+        num_binop('%', b, a, &b, err);     // gcd(a, b) = gcd(a, b mod a), now both small
+    }
+    if (!a.big && !b.big) return num_from_u64(gcd_u64(num_mag_u64(a), num_mag_u64(b)));
+    return num_from_big(big_gcd(num_to_big(a), num_to_big(b)));
+}
+
+static void rat_normalize(Rat *r) {
+    char err[128];
+    Num g = num_gcd(r->num, r->den);
+    if (!g.big && g.small == 1) return;
+    num_binop('/', r->num, g, &r->num, err);
+    num_binop('/', r->den, g, &r->den, err);
+}
+
+// Lazy normalization: only once a component has been promoted to a Big.
+static void rat_settle(Rat *r) {
+    if (num_sign(r->den) < 0) { r->num = num_neg(r->num); r->den = num_neg(r->den); }
+    if (r->num.big || r->den.big) rat_normalize(r);
+}
+
+static int rat_binop(char op, Rat a, Rat b, Rat *r, char *err_msg) {
+    Num t, u;
+    switch (op) {
+        case '+': case '-':
+            if (!a.den.big && !b.den.big && a.den.small == b.den.small) {
+                if (!num_binop(op, a.num, b.num, &r->num, err_msg)) return 0;
+                r->den = a.den;
+                break;
+            }
+            if (!num_binop('*', a.num, b.den, &t, err_msg)) return 0;
+            if (!num_binop('*', b.num, a.den, &u, err_msg)) return 0;
+            if (!num_binop(op, t, u, &r->num, err_msg)) return 0;
+            if (!num_binop('*', a.den, b.den, &r->den, err_msg)) return 0;
+            break;
+        case '*':
+            if (!num_binop('*', a.num, b.num, &r->num, err_msg)) return 0;
+            if (!num_binop('*', a.den, b.den, &r->den, err_msg)) return 0;
+            break;
+        case '/':
+            if (num_sign(b.num) == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+            if (!num_binop('*', a.num, b.den, &r->num, err_msg)) return 0;
+            if (!num_binop('*', a.den, b.num, &r->den, err_msg)) return 0;
+            break;
+        case '%': {
+            // a - b * trunc(a / b)
+            if (num_sign(b.num) == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+            Num q;
+            if (!num_binop('*', a.num, b.den, &t, err_msg)) return 0;
+            if (!num_binop('*', a.den, b.num, &u, err_msg)) return 0;
+            if (!num_binop('/', t, u, &q, err_msg)) return 0;
+            if (!num_binop('*', q, b.num, &u, err_msg)) return 0;
+            if (!num_binop('*', u, a.den, &u, err_msg)) return 0;
+            if (!num_binop('-', t, u, &r->num, err_msg)) return 0;
+            if (!num_binop('*', a.den, b.den, &r->den, err_msg)) return 0;
+            break;
+        }
+        case '^': {
+            rat_normalize(&b);
+            if (b.den.big || b.den.small != 1) { strcpy(err_msg,"Exponent must be an integer"); return 0; }
+            if (b.num.big) { strcpy(err_msg,"Invalid or overflow in exponentiation"); return 0; }
+            rat_normalize(&a); // a reduced base keeps the power reduced
+            if (b.num.small < 0) {
+                if (num_sign(a.num) == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+                t = a.num; a.num = a.den; a.den = t;
+                b.num = num_neg(b.num);
+            }
+            if (!num_binop('^', a.num, b.num, &r->num, err_msg)) return 0;
+            if (!num_binop('^', a.den, b.num, &r->den, err_msg)) return 0;
+            break;
+        }
+        default:
+            strcpy(err_msg,"Unknown operator in evaluation");
+            return 0;
+    }
+    rat_settle(r);
+    return 1;
+}
+
+static inline int rational_literal(const Token *t, Rat *out, char *err_msg) {
+    if (t->decimal) { strcpy(err_msg,"Decimal literals need --fixed or --double"); return 0; }
+    out->num = num_from_dec(t->text, t->len);
+    out->den = num_small(1);
+    return 1;
+}
+
+static inline int rational_negate(Rat *v, char *err_msg) {
+    (void)err_msg;
+    v->num = num_neg(v->num);
+    return 1;
+}
+
+static inline int rational_binary(char op, Rat a, Rat b, Rat *out, char *err_msg) {
+    int truth;
+    if (is_comparison(op)) {
+        Num t, u; // denominators are positive, so compare the cross products
+        num_binop('*', a.num, b.den, &t, err_msg);
+        num_binop('*', b.num, a.den, &u, err_msg);
+        truth = comparison_holds(op, num_cmp(t, u));
+    } else if (op == '&' || op == '|') {
+        int x = !num_is_zero(a.num), y = !num_is_zero(b.num);
+        truth = op == '&' ? x && y : x || y;
+    } else {
+        return rat_binop(op, a, b, out, err_msg);
+    }
+    out->num = num_small(truth);
+    out->den = num_small(1);
+    return 1;
+}
+
+DEFINE_ENGINE(rational, Rat, RatStack)
+
+// "num" or "num/den" in lowest terms, in the arena.
+char *rat_to_dec(Rat r) {
+    rat_normalize(&r);
+    char *n = num_to_dec(r.num);
+    if (!r.den.big && r.den.small == 1) return n;
+    char *d = num_to_dec(r.den);
+    char *out = arena_alloc(big_arena, strlen(n) + strlen(d) + 2);
+    sprintf(out, "%s/%s", n, d);
+    return out;
+}
+
+// -------------------- Fixed-point decimal evaluation --------------------
+// Values are long longs holding value * 10^scale. Products and quotients are
+// formed in 128 bits and rounded back with the selected rounding mode; a
+// product that fits in 64 bits is rescaled with the DivMagic for 10^scale.
+#define FIXED_MAX_SCALE 18
+
+enum { ROUND_HALF_EVEN, ROUND_HALF_UP, ROUND_DOWN, ROUND_FLOOR, ROUND_CEILING };
+
+static int fixed_scale = 4;
+static int fixed_round = ROUND_HALF_EVEN;
+static long long fixed_one = 10000;   // 10^fixed_scale
+static DivMagic fixed_one_div;
+
+void fixed_init(int scale, int round_mode) {
+    fixed_scale = scale;
+    fixed_round = round_mode;
+    fixed_one = 1;
+    for (int i = 0; i < scale; ++i) fixed_one *= 10;
+    divmagic_init(&fixed_one_div, fixed_one);
+}
+
+// Adjust a truncated quotient q (remainder r, divisor d) per the rounding mode.
+static __int128 fixed_round_quot(__int128 q, __int128 r, __int128 d) {
+    if (r == 0) return q;
+    int neg = (r < 0) != (d < 0);           // sign of the exact quotient
+    __int128 ar = r < 0 ? -r : r, ad = d < 0 ? -d : d;
+    int up = 0;                              // step away from zero?
+    switch (fixed_round) {
+        case ROUND_HALF_EVEN: up = 2 * ar > ad || (2 * ar == ad && (q & 1)); break;
+        case ROUND_HALF_UP:   up = 2 * ar >= ad; break;
+        case ROUND_DOWN:      up = 0; break;
+        case ROUND_FLOOR:     up = neg; break;
+        case ROUND_CEILING:   up = !neg; break;
+    }
+    return up ? (neg ? q - 1 : q + 1) : q;
+}
+
+static int fixed_fits(__int128 v) { return v >= LLONG_MIN && v <= LLONG_MAX; }
+
+// n / d rounded; d != 0.
+static int fixed_div_round(__int128 n, __int128 d, long long *out) {
+    __int128 q;
+    if (d == fixed_one && fixed_fits(n)) {
+        long long q64 = divmagic_div(&fixed_one_div, (long long)n);
+        q = fixed_round_quot(q64, (long long)n - q64 * fixed_one, d);
+    } else {
+        q = fixed_round_quot(n / d, n % d, d);
+    }
+    if (!fixed_fits(q)) return 0;
+    *out = (long long)q;
+    return 1;
+}
+
+static int fixed_mul(long long a, long long b, long long *out) {
+    return fixed_div_round((__int128)a * b, fixed_one, out);
+}
+
+// Literal "123.4567..." -> scaled integer, extra fraction digits rounded.
+static int fixed_from_dec(const char *s, int len, long long *out) {
+    __int128 v = 0, scale_left = fixed_scale;
+    int i = 0, frac = 0;
+    for (; i < len; ++i) {
+        if (s[i] == '.') { frac = 1; continue; }
+        if (frac && scale_left == 0) break;
+        v = v * 10 + (s[i] - '0');
+        if (frac) scale_left--;
+        if (v > LLONG_MAX) return 0;
+    }
+    // digits beyond the scale: round on the truncated tail
+    __int128 rem = 0, div = 1;
+    int k = i;
+    for (; k < len && k < i + 18; ++k) { rem = rem * 10 + (s[k] - '0'); div *= 10; }
+    for (; k < len; ++k) if (s[k] != '0') { rem = rem * 10 + 1; div *= 10; break; } // sticky digit
+    for (; scale_left > 0; --scale_left) { v *= 10; if (v > LLONG_MAX) return 0; }
+    v = fixed_round_quot(v, rem, div);
+    if (v > LLONG_MAX) return 0;
+    *out = (long long)v;
+    return 1;
+}
+
+static char *fixed_to_dec(long long v, char *buf) {
+    unsigned long long m = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    unsigned long long one = (unsigned long long)fixed_one;
+    char *p = buf;
+    if (v < 0) *p++ = '-';
+    p += sprintf(p, "%llu", m / one);
+    if (fixed_scale) sprintf(p, ".%0*llu", fixed_scale, m % one);
+    return buf;
+}
+
+static inline int fixed_literal(const Token *t, long long *out, char *err_msg) {
+    if (t->decimal & LIT_EXPONENT) { strcpy(err_msg,"Exponent literals need --double"); return 0; }
+    if (!fixed_from_dec(t->text, t->len, out)) { strcpy(err_msg,"Number out of fixed-point range"); return 0; }
+    return 1;
+}
+
+static inline int fixed_negate(long long *v, char *err_msg) {
+    if (*v == LLONG_MIN) { strcpy(err_msg,"Fixed-point overflow"); return 0; }
+    *v = -*v;
+    return 1;
+}
+
+static inline int fixed_binary(char op, long long a, long long b, long long *out, char *err_msg) {
+    long long r = 0;
+    int ok = 1;
+
+    if (is_comparison(op)) { *out = comparison_holds(op, (a > b) - (a < b)) ? fixed_one : 0; return 1; }
+    switch (op) {
+        case '+': ok = !__builtin_add_overflow(a, b, &r); break;
+        case '-': ok = !__builtin_sub_overflow(a, b, &r); break;
+        case '*': ok = fixed_mul(a, b, &r); break;
+        case '/':
+            if (b == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+            ok = fixed_div_round((__int128)a * fixed_one, b, &r);
+            break;
+        case '%':
+            // a - b*trunc(a/b) is exact on the scaled integers
+            if (b == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+            r = (b == -1) ? 0 : a % b;
+            break;
+        case '^': {
+            if (b % fixed_one) { strcpy(err_msg,"Exponent must be an integer"); return 0; }
+            long long e = b / fixed_one;
+            unsigned long long ue = e < 0 ? 0ULL - (unsigned long long)e : (unsigned long long)e;
+            long long base = a, acc = fixed_one;
+            // square-and-multiply, rounding after every product
+            for (; ue && ok; ue >>= 1) {
+                if (ue & 1) ok = fixed_mul(acc, base, &acc);
+                if (ok && ue > 1) ok = fixed_mul(base, base, &base);
+            }
+            if (ok && e < 0) {
+                if (acc == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+                ok = fixed_div_round((__int128)fixed_one * fixed_one, acc, &acc);
+            }
+            r = acc;
+            break;
+        }
+        case '&': r = (a && b) ? fixed_one : 0; break;
+        case '|': r = (a || b) ? fixed_one : 0; break;
+        default:
+            strcpy(err_msg,"Unknown operator in evaluation");
+            return 0;
+    }
+    if (!ok) { strcpy(err_msg,"Fixed-point overflow"); return 0; }
+    *out = r;
+    return 1;
+}
+
+DEFINE_ENGINE(fixed, long long, FixedStack)
+
+// -------------------- Double-precision evaluation --------------------
+// Literals are parsed with Clinger's exact fast path, then the Eisel-Lemire
+// algorithm (one or two 64x128-bit products against a truncated power of
+// five), and strtod only for the rare ambiguous or subnormal cases. Results
+// are printed with Ryu: the shortest digit string that round-trips.
+// Both power-of-five tables are derived once with the bignum code above.
+#define LEMIRE_MIN_Q   (-342)
+#define LEMIRE_MAX_Q   308
+#define RYU_INV_TABLE  342
+#define RYU_POS_TABLE  326
+#define RYU_POW5_BITS  125
+
+static uint64_t lemire_pow5[LEMIRE_MAX_Q - LEMIRE_MIN_Q + 1][2]; // {high, low} of 5^q, 128 bits
+static uint64_t ryu_pow5_inv[RYU_INV_TABLE][2];                  // {low, high}
+static uint64_t ryu_pow5[RYU_POS_TABLE][2];                      // {low, high}
+static int double_tables_ready = 0;
+
+static Big big_shift(Big a, long long bits) {
+    if (bits < 0) {
+        limb_t *d = limbs_alloc(a.n);
+        memcpy(d, a.d, (size_t)a.n * sizeof(limb_t));
+        int n = mag_shr_any(d, a.n, -bits);
+        return big_make(d, n, a.neg);
+    }
+    int ls = (int)(bits / 32);
+    limb_t *d = limbs_alloc(a.n + ls + 1);
+    memset(d, 0, (size_t)ls * sizeof(limb_t));
+    mag_shl_bits(a.d, a.n, (int)(bits % 32), d + ls);
+    return big_make(d, a.n + ls + 1, a.neg);
+}
+
+static void big_low128(Big a, uint64_t *lo, uint64_t *hi) {
+    limb_t l[4] = {0, 0, 0, 0};
+    memcpy(l, a.d, (size_t)(a.n < 4 ? a.n : 4) * sizeof(limb_t));
+    *lo = ((uint64_t)l[1] << 32) | l[0];
+    *hi = ((uint64_t)l[3] << 32) | l[2];
+}
+
+static void double_tables_init(void) {
+    if (double_tables_ready) return;
+    Arena tmp; arena_init(&tmp);
+    Arena *saved = big_arena;
+    big_arena = &tmp;
+    Big one = big_from_ll(1), five = big_from_ll(5);
+
+    Big p = one;
+    for (int i = 0; i < RYU_INV_TABLE || i <= -LEMIRE_MIN_Q; ++i) {
+        long long len = big_bits(&p);
+        if (i < RYU_INV_TABLE) {
+            Big q;
+            big_divmod(big_shift(one, len - 1 + RYU_POW5_BITS), p, &q, NULL);
+            big_low128(big_add(q, one), &ryu_pow5_inv[i][0], &ryu_pow5_inv[i][1]);
+        }
+        if (i < RYU_POS_TABLE)
+            big_low128(big_shift(p, RYU_POW5_BITS - len), &ryu_pow5[i][0], &ryu_pow5[i][1]);
+        if (i <= LEMIRE_MAX_Q) // 5^i normalized to exactly 128 bits, truncated
+            big_low128(big_shift(p, 128 - len), &lemire_pow5[i - LEMIRE_MIN_Q][1], &lemire_pow5[i - LEMIRE_MIN_Q][0]);
+        if (i > 0 && i <= -LEMIRE_MIN_Q) {
+            // 2^b / 5^i + 1, truncated to 128 bits
+            long long b = i <= 27 ? len + 127 : 2 * len + 128;
+            Big q;
+            big_divmod(big_shift(one, b), p, &q, NULL);
+            q = big_add(q, one);
+            if (big_bits(&q) > 128) q = big_shift(q, 128 - big_bits(&q));
+            big_low128(q, &lemire_pow5[-i - LEMIRE_MIN_Q][1], &lemire_pow5[-i - LEMIRE_MIN_Q][0]);
+        }
+        p = big_mul(p, five);
+    }
+    big_arena = saved;
+    arena_free(&tmp);
+    double_tables_ready = 1;
+}
+
+// ---- parsing ----
+static const double exact_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// w * 10^q for w != 0; 0 if the fast algorithm cannot decide.
+static int lemire_compute(uint64_t w, long long q, double *out) {
+    if (q < LEMIRE_MIN_Q) { *out = 0.0; return 1; }
+    if (q > LEMIRE_MAX_Q) { *out = HUGE_VAL; return 1; }
+
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    const uint64_t *t = lemire_pow5[q - LEMIRE_MIN_Q];
+    unsigned __int128 first = (unsigned __int128)w * t[0];
+    uint64_t hi = (uint64_t)(first >> 64), lo = (uint64_t)first;
+    const uint64_t mask = 0xFFFFFFFFFFFFFFFFULL >> 55; // 52 mantissa bits + 3
+    if ((hi & mask) == mask) {
+        unsigned __int128 second = (unsigned __int128)w * t[1];
+        uint64_t s_hi = (uint64_t)(second >> 64);
+        lo += s_hi;
+        if (s_hi > lo) hi++;
+        if (lo == 0xFFFFFFFFFFFFFFFFULL && (q < -27 || q > 55)) return 0;
+    }
+
+    int upper = (int)(hi >> 63);
+    int shift = upper + 64 - 52 - 3;
+    uint64_t mantissa = hi >> shift;
+    long long power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + 1023;
+    if (power2 <= 0) return 0; // subnormal: leave to strtod
+
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi)
+        mantissa &= ~1ULL; // exact halfway: round to even
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << 52)) { mantissa = 1ULL << 52; power2++; }
+    mantissa &= ~(1ULL << 52);
+    if (power2 >= 0x7FF) { *out = HUGE_VAL; return 1; }
+
+    uint64_t bits = mantissa | ((uint64_t)power2 << 52);
+    memcpy(out, &bits, sizeof(bits));
+    return 1;
+}
+
+static double double_from_dec_slow(const char *s, int len) {
+    char *buf = malloc((size_t)len + 1);
+    if (!buf) { fputs("Out of memory\n", stderr); exit(1); }
+    memcpy(buf, s, (size_t)len);
+    buf[len] = '\0';
+    double d = strtod(buf, NULL);
+    free(buf);
+    return d;
+}
+
+double double_from_dec(const char *s, int len) {
+    uint64_t w = 0;
+    int digits = 0, truncated = 0, i = 0;
+    long long q = 0;
+
+    int after_point = 0;
+    for (; i < len && s[i] != 'e' && s[i] != 'E'; ++i) {
+        if (s[i] == '.') { after_point = 1; continue; }
+        if (digits == 0 && s[i] == '0') { if (after_point) q--; continue; }
+        if (digits < 19) { w = w * 10 + (uint64_t)(s[i] - '0'); digits++; if (after_point) q--; }
+        else { truncated |= s[i] != '0'; if (!after_point) q++; }
+    }
+    if (i < len) {
+        int neg = 0; long long e = 0;
+        i++;
+        if (s[i] == '+' || s[i] == '-') neg = s[i++] == '-';
+        for (; i < len; ++i) if (e < 100000) e = e * 10 + (s[i] - '0');
+        q += neg ? -e : e;
+    }
+
+    if (w == 0) return 0.0;
+    if (truncated) return double_from_dec_slow(s, len);
+    if (w <= (1ULL << 53) && q >= -22 && q <= 22)
+        return q < 0 ? (double)w / exact_pow10[-q] : (double)w * exact_pow10[q];
+
+    double d;
+    if (lemire_compute(w, q, &d)) return d;
+    return double_from_dec_slow(s, len);
+}
+
+// ---- Ryu shortest printing ----
+static inline int ryu_pow5bits(int e) { return (int)(((uint32_t)e * 1217359) >> 19) + 1; }
+static inline int ryu_log10_pow2(int e) { return (int)(((uint32_t)e * 78913) >> 18); }
+static inline int ryu_log10_pow5(int e) { return (int)(((uint32_t)e * 732923) >> 20); }
+
+static inline int ryu_pow5_factor(uint64_t v) {
+    int count = 0;
+    while (v % 5 == 0) { v /= 5; count++; }
+    return count;
+}
+
+static inline uint64_t ryu_mul_shift(uint64_t m, const uint64_t *mul, int j) {
+    unsigned __int128 b0 = (unsigned __int128)m * mul[0];
+    unsigned __int128 b2 = (unsigned __int128)m * mul[1];
+    return (uint64_t)(((b0 >> 64) + b2) >> (j - 64));
+}
+
+// Shortest decimal m * 10^e for a finite positive double's fields.
+static void ryu_d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent, uint64_t *out_m, int *out_e) {
+    int e2;
+    uint64_t m2;
+    if (ieee_exponent == 0) { e2 = 1 - 1023 - 52 - 2; m2 = ieee_mantissa; }
+    else { e2 = (int)ieee_exponent - 1023 - 52 - 2; m2 = (1ULL << 52) | ieee_mantissa; }
+    int accept_bounds = (m2 & 1) == 0;
+    uint64_t mv = 4 * m2;
+    uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int e10;
+    int vm_trailing_zeros = 0, vr_trailing_zeros = 0;
+    if (e2 >= 0) {
+        int q = ryu_log10_pow2(e2) - (e2 > 3);
+        e10 = q;
+        int k = RYU_POW5_BITS + ryu_pow5bits(q) - 1;
+        int i = -e2 + q + k;
+        vr = ryu_mul_shift(4 * m2, ryu_pow5_inv[q], i);
+        vp = ryu_mul_shift(4 * m2 + 2, ryu_pow5_inv[q], i);
+        vm = ryu_mul_shift(4 * m2 - 1 - mm_shift, ryu_pow5_inv[q], i);
+        if (q <= 21) {
+            if (mv % 5 == 0) vr_trailing_zeros = ryu_pow5_factor(mv) >= q;
+            else if (accept_bounds) vm_trailing_zeros = ryu_pow5_factor(mv - 1 - mm_shift) >= q;
+            else vp -= ryu_pow5_factor(mv + 2) >= q;
+        }
+    } else {
+        int q = ryu_log10_pow5(-e2) - (-e2 > 1);
+        e10 = q + e2;
+        int i = -e2 - q;
+        int k = ryu_pow5bits(i) - RYU_POW5_BITS;
+        int j = q - k;
+        vr = ryu_mul_shift(4 * m2, ryu_pow5[i], j);
+        vp = ryu_mul_shift(4 * m2 + 2, ryu_pow5[i], j);
+        vm = ryu_mul_shift(4 * m2 - 1 - mm_shift, ryu_pow5[i], j);
+        if (q <= 1) {
+            vr_trailing_zeros = 1;
+            if (accept_bounds) vm_trailing_zeros = mm_shift == 1;
+            else --vp;
+        } else if (q < 63) {
+            vr_trailing_zeros = (mv & ((1ULL << q) - 1)) == 0;
+        }
+    }
+
+    int removed = 0;
+    uint8_t last_removed = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = (uint8_t)(vr % 10);
+            vr /= 10; vp /= 10; vm /= 10;
+            ++removed;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = (uint8_t)(vr % 10);
+                vr /= 10; vp /= 10; vm /= 10;
+                ++removed;
+            }
+        }
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) last_removed = 4; // round to even
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed >= 5);
+    } else {
+        int round_up = 0;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100; vp /= 100; vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10; vp /= 10; vm /= 10;
+            ++removed;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+    *out_m = output;
+    *out_e = e10 + removed;
+}
+
+// Shortest round-trip text: plain notation for moderate exponents, otherwise d.ddde+x.
+char *double_to_shortest(double d, char *buf) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int neg = (int)(bits >> 63);
+    uint32_t ieee_exponent = (uint32_t)((bits >> 52) & 0x7FF);
+    uint64_t ieee_mantissa = bits & ((1ULL << 52) - 1);
+    char *p = buf;
+
+    if (ieee_exponent == 0x7FF) { strcpy(buf, ieee_mantissa ? "nan" : neg ? "-inf" : "inf"); return buf; }
+    if (neg) *p++ = '-';
+    if (ieee_exponent == 0 && ieee_mantissa == 0) { strcpy(p, "0"); return buf; }
+
+    uint64_t m; int e;
+    ryu_d2d(ieee_mantissa, ieee_exponent, &m, &e);
+    char digits[24];
+    int n = sprintf(digits, "%llu", (unsigned long long)m);
+    int point = n + e; // position of the decimal point relative to the first digit
+
+    if (point > 21 || point < -5) {
+        *p++ = digits[0];
+        if (n > 1) { *p++ = '.'; memcpy(p, digits + 1, (size_t)n - 1); p += n - 1; }
+        sprintf(p, "e%+d", point - 1);
+    } else if (point <= 0) {
+        *p++ = '0'; *p++ = '.';
+        for (int i = 0; i < -point; ++i) *p++ = '0';
+        memcpy(p, digits, (size_t)n); p[n] = '\0';
+    } else if (point >= n) {
+        memcpy(p, digits, (size_t)n); p += n;
+        for (int i = n; i < point; ++i) *p++ = '0';
+        *p = '\0';
+    } else {
+        memcpy(p, digits, (size_t)point); p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, (size_t)(n - point)); p[n - point] = '\0';
+    }
+    return buf;
+}
+
+// ---- evaluation ----
+static inline int double_literal(const Token *t, double *out, char *err_msg) {
+    (void)err_msg;
+    double_tables_init();
+    *out = double_from_dec(t->text, t->len);
+    return 1;
+}
+
+static inline int double_negate(double *v, char *err_msg) {
+    (void)err_msg;
+    *v = -*v;
+    return 1;
+}
+
+static inline int double_binary(char op, double a, double b, double *out, char *err_msg) {
+    double r;
+
+    switch (op) {
+        case '+': r = a + b; break;
+        case '-': r = a - b; break;
+        case '*': r = a * b; break;
+        case '/':
+            if (b == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+            r = a / b; break;
+        case '%':
+            if (b == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+            r = fmod(a, b); break; // sign of the dividend, like integer %
+        case '^': r = pow(a, b); break;
+        case '&': r = a != 0 && b != 0; break; // NaN counts as true
+        case '|': r = a != 0 || b != 0; break;
+        default:
+            if (is_comparison(op)) { r = comparison_holds(op, a < b ? -1 : a > b ? 1 : a == b ? 0 : 2); break; }
+            strcpy(err_msg,"Unknown operator in evaluation");
+            return 0;
+    }
+    *out = r;
+    return 1;
+}
+
+DEFINE_ENGINE(double, double, DoubleStack)
+
+// -------------------- Modular evaluation --------------------
+// Every result is reduced mod N (2 <= N < 2^64). Odd moduli keep values in
+// Montgomery form so products reduce with two multiplications and no divide;
+// even moduli use Barrett reduction with a precomputed 2^128 / N.
+// Values also carry their exact integer value, as a sign and a 64-bit
+// magnitude, for as long as + - * / % ^ keep it in range, so that '^' raises
+// to the real exponent; an exponent whose exact value was lost is an error
+// rather than being replaced by its residue.
+typedef struct {
+    uint64_t n;
+    int montgomery;          // odd modulus
+    uint64_t ninv;           // -n^-1 mod 2^64
+    uint64_t r2;             // 2^128 mod n
+    unsigned __int128 mu;    // floor((2^128 - 1) / n), Barrett
+} ModCtx;
+
+typedef struct {
+    uint64_t r;              // residue (Montgomery form for odd moduli)
+    uint64_t exact;          // magnitude of the exact value
+    int negative;            // sign of the exact value; never set for 0
+    int has_exact;
+} ModVal;
+
+static ModCtx mod_ctx;
+
+void mod_init(uint64_t n) {
+    ModCtx *c = &mod_ctx;
+    c->n = n;
+    c->montgomery = (int)(n & 1);
+    if (c->montgomery) {
+        uint64_t inv = n;                         // Newton: correct to 5, 10, 20, 40, 80 bits
+        for (int i = 0; i < 5; ++i) inv *= 2 - n * inv;
+        c->ninv = 0 - inv;
+        uint64_t r1 = (uint64_t)(((unsigned __int128)1 << 64) % n);
+        c->r2 = (uint64_t)(((unsigned __int128)r1 * r1) % n);
+    } else {
+        c->mu = ~(unsigned __int128)0 / n;
+    }
+}
+
+static inline uint64_t mod_redc(unsigned __int128 t) {
+    uint64_t m = (uint64_t)t * mod_ctx.ninv;
+    unsigned __int128 mn = (unsigned __int128)m * mod_ctx.n;
+    unsigned __int128 s = (t >> 64) + (mn >> 64) + ((uint64_t)t != 0);
+    return (uint64_t)(s >= mod_ctx.n ? s - mod_ctx.n : s);
+}
+
+// x mod n for x < n^2 via q = floor(x * mu / 2^128), then at most two corrections.
+static inline uint64_t mod_barrett(unsigned __int128 x) {
+    uint64_t xl = (uint64_t)x, xh = (uint64_t)(x >> 64);
+    uint64_t ml = (uint64_t)mod_ctx.mu, mh = (uint64_t)(mod_ctx.mu >> 64);
+    unsigned __int128 ll = (unsigned __int128)xl * ml, lh = (unsigned __int128)xl * mh;
+    unsigned __int128 hl = (unsigned __int128)xh * ml, hh = (unsigned __int128)xh * mh;
+    unsigned __int128 mid = (ll >> 64) + (uint64_t)lh + (uint64_t)hl;
+    unsigned __int128 q = hh + (lh >> 64) + (hl >> 64) + (mid >> 64);
+    unsigned __int128 r = x - q * mod_ctx.n;
+    while (r >= mod_ctx.n) r -= mod_ctx.n;
+    return (uint64_t)r;
+}
+
+static inline uint64_t mod_mul(uint64_t a, uint64_t b) {
+    unsigned __int128 p = (unsigned __int128)a * b;
+    return mod_ctx.montgomery ? mod_redc(p) : mod_barrett(p);
+}
+
+static inline uint64_t mod_add(uint64_t a, uint64_t b) {
+    uint64_t s = a + b;
+    return (s < a || s >= mod_ctx.n) ? s - mod_ctx.n : s;
+}
+
+static inline uint64_t mod_sub(uint64_t a, uint64_t b) {
+    return a >= b ? a - b : a - b + mod_ctx.n;
+}
+
+// Canonical residue <-> internal form
+static inline uint64_t mod_in(uint64_t v) {
+    v %= mod_ctx.n;
+    return mod_ctx.montgomery ? mod_redc((unsigned __int128)v * mod_ctx.r2) : v;
+}
+static inline uint64_t mod_out(uint64_t r) { return mod_ctx.montgomery ? mod_redc(r) : r; }
+
+static uint64_t mod_pow(uint64_t base, unsigned long long e) {
+    uint64_t acc = mod_in(1);
+    for (; e; e >>= 1) {
+        if (e & 1) acc = mod_mul(acc, base);
+        if (e > 1) base = mod_mul(base, base);
+    }
+    return acc;
+}
+
+// Inverse of a canonical residue by the extended Euclidean algorithm; 0 if none.
+static int mod_inverse(uint64_t a, uint64_t *out) {
+    __int128 t = 0, nt = 1;
+    uint64_t r = mod_ctx.n, nr = a;
+    while (nr) {
+        uint64_t q = r / nr, tmp = r - q * nr;
+        __int128 tt = t - (__int128)q * nt;
+        t = nt; nt = tt; r = nr; nr = tmp;
+    }
+    if (r != 1) return 0;
+    if (t < 0) t += mod_ctx.n;
+    *out = (uint64_t)t;
+    return 1;
+}
+
+static ModVal mod_from_dec(const char *s, int len) {
+    ModVal v = { 0, 0, 0, 1 };
+    uint64_t acc = 0;
+    for (int i = 0; i < len; ) {
+        int chunk = (len - i) % 19 ? (len - i) % 19 : 19;
+        uint64_t part = 0, scale = 1;
+        for (int k = 0; k < chunk; ++k, ++i) { part = part * 10 + (uint64_t)(s[i] - '0'); scale *= 10; }
+        acc = mod_add(mod_mul(acc, mod_in(scale)), mod_in(part));
+        if (v.has_exact) {
+            unsigned __int128 x = (unsigned __int128)v.exact * scale + part;
+            if (x > UINT64_MAX) v.has_exact = 0;
+            else v.exact = (uint64_t)x;
+        }
+    }
+    v.r = acc;
+    return v;
+}
+
+static inline int mod_literal(const Token *t, ModVal *out, char *err_msg) {
+    if (t->decimal) { strcpy(err_msg,"Decimal literals need --fixed or --double"); return 0; }
+    *out = mod_from_dec(t->text, t->len);
+    return 1;
+}
+
+static inline int mod_negate(ModVal *a, char *err_msg) {
+    (void)err_msg;
+    a->r = mod_sub(0, a->r);
+    a->negative = !a->negative && a->exact != 0;
+    return 1;
+}
+
+// Exact a + b, or a - b if sub; 0 if the magnitude needs more than 64 bits.
+static inline int mod_exact_add(ModVal a, ModVal b, int sub, ModVal *r) {
+    int bneg = b.negative ^ sub;
+    if (a.negative == bneg) {
+        r->negative = a.negative;
+        if (__builtin_add_overflow(a.exact, b.exact, &r->exact)) return 0;
+    } else if (a.exact >= b.exact) {
+        r->exact = a.exact - b.exact;
+        r->negative = a.negative;
+    } else {
+        r->exact = b.exact - a.exact;
+        r->negative = bneg;
+    }
+    r->negative &= r->exact != 0;
+    return 1;
+}
+
+// base^e into *out; 0 if it needs more than 64 bits.
+static int mod_exact_pow(uint64_t base, uint64_t e, uint64_t *out) {
+    uint64_t acc = 1;
+    if (base <= 1) { *out = e ? base : 1; return 1; }
+    for (; e; e >>= 1) {
+        if ((e & 1) && __builtin_mul_overflow(acc, base, &acc)) return 0;
+        if (e > 1 && __builtin_mul_overflow(base, base, &base)) return 0; // a higher bit still multiplies by it
+    }
+    *out = acc;
+    return 1;
+}
+
+static inline int mod_binary(char op, ModVal a, ModVal b, ModVal *out, char *err_msg) {
+    ModVal r = { 0, 0, 0, 0 };
+    int both = a.has_exact && b.has_exact;
+
+    // Comparisons order the canonical residues 0..N-1; only 0 is false.
+    if (is_comparison(op) || op == '&' || op == '|') {
+        uint64_t x = mod_out(a.r), y = mod_out(b.r);
+        int truth = op == '&' ? x && y : op == '|' ? x || y : comparison_holds(op, (x > y) - (x < y));
+        ModVal v = { mod_in((uint64_t)truth), (uint64_t)truth, 0, 1 };
+        *out = v;
+        return 1;
+    }
+
+    switch (op) {
+        case '+':
+            r.r = mod_add(a.r, b.r);
+            r.has_exact = both && mod_exact_add(a, b, 0, &r);
+            break;
+        case '-':
+            r.r = mod_sub(a.r, b.r);
+            r.has_exact = both && mod_exact_add(a, b, 1, &r);
+            break;
+        case '*':
+            r.r = mod_mul(a.r, b.r);
+            r.has_exact = both && !__builtin_mul_overflow(a.exact, b.exact, &r.exact);
+            r.negative = (a.negative ^ b.negative) && r.exact != 0;
+            break;
+        case '/': {
+            uint64_t inv;
+            if (mod_out(b.r) == 0) { strcpy(err_msg,"Division by zero"); return 0; }
+            if (!mod_inverse(mod_out(b.r), &inv)) { strcpy(err_msg,"Divisor has no inverse modulo N"); return 0; }
+            r.r = mod_mul(a.r, mod_in(inv));
+            if (both && a.exact % b.exact == 0) { // an exact quotient is also the modular one
+                r.exact = a.exact / b.exact;
+                r.negative = (a.negative ^ b.negative) && r.exact != 0;
+                r.has_exact = 1;
+            }
+            break;
+        }
+        case '%': {
+            if (both) {
+                // remainder of the exact values, taking the sign of a
+                if (b.exact == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+                r.exact = a.exact % b.exact;
+                r.negative = a.negative && r.exact != 0;
+                r.has_exact = 1;
+                r.r = r.negative ? mod_sub(0, mod_in(r.exact)) : mod_in(r.exact);
+                break;
+            }
+            // otherwise the remainder of the canonical representatives
+            uint64_t y = mod_out(b.r);
+            if (y == 0) { strcpy(err_msg,"Modulo by zero"); return 0; }
+            r.r = mod_in(mod_out(a.r) % y);
+            break;
+        }
+        case '^': {
+            if (!b.has_exact) { strcpy(err_msg,"Exponent is not an exact integer"); return 0; }
+            uint64_t base = a.r;
+            if (b.negative) {
+                uint64_t inv;
+                if (!mod_inverse(mod_out(a.r), &inv)) { strcpy(err_msg,"Base has no inverse modulo N"); return 0; }
+                base = mod_in(inv);
+            }
+            r.r = mod_pow(base, b.exact);
+            if (!a.has_exact) break;
+            if (b.negative) { // only 1 and -1 have integer reciprocals
+                r.exact = 1;
+                r.has_exact = a.exact == 1;
+            } else {
+                r.has_exact = mod_exact_pow(a.exact, b.exact, &r.exact);
+            }
+            r.negative = a.negative && (b.exact & 1) && r.exact != 0;
+            break;
+        }
+        default:
+            strcpy(err_msg,"Unknown operator in evaluation");
+            return 0;
+    }
+    *out = r;
+    return 1;
+}
+
+DEFINE_ENGINE(mod, ModVal, ModStack)
+
+// -------------------- Utility: join postfix tokens to a printable string --------------------
+void print_postfix(const TokenList *postfix) {
+    for (int i = 0; i < postfix->count; ++i) {
+        // Print unary minus as '~' just for display clarity
+        const Token *t = &postfix->items[i];
+        if (t->op) fputs(operator_text(t->op), stdout);
+        else fwrite(t->text, 1, (size_t)t->len, stdout);
+        if (i + 1 < postfix->count) putchar(' ');
+    }
+    putchar('\n');
+}
+
+// -------------------- Result cache --------------------
+// Results of the interactive evaluator, keyed by a canonical form of the
+// expression so that trivially different repeats share an entry. Entries
+// are evicted by CLOCK: a hand sweeps the slots, clearing reference bits and
+// evicting the first entry whose bit is already clear. The cache holds at
+// most capacity entries and CACHE_MAX_BYTES of keys and results. Only
+// results are cached, never errors: with commutative operands sorted, an
+// expression with two failing operands could otherwise report the other one.
+#define CACHE_MAX_BYTES (64 << 20)
+
+typedef struct {
+    char *key;              // key then result in one allocation; NULL if free
+    const char *value;
+    size_t len, size;       // key length, allocation size
+    uint64_t hash;
+    int next;               // bucket chain, or free list, -1 at the end
+    int referenced;
+} CacheEntry;
+
+typedef struct {
+    CacheEntry *entry;
+    int *bucket;
+    int capacity, count, buckets, hand, free;
+    size_t bytes;
+    size_t hits, misses, evictions;
+} ResultCache;
+
+void result_cache_init(ResultCache *c, int capacity) {
+    memset(c, 0, sizeof(*c));
+    c->capacity = capacity;
+    c->free = -1;
+    for (c->buckets = 16; c->buckets < capacity; c->buckets *= 2) {}
+    c->entry = malloc((size_t)(capacity ? capacity : 1) * sizeof(CacheEntry));
+    c->bucket = malloc((size_t)c->buckets * sizeof(int));
+    if (!c->entry || !c->bucket) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int b = 0; b < c->buckets; ++b) c->bucket[b] = -1;
+}
+
+void result_cache_free(ResultCache *c) {
+    for (int i = 0; i < c->count; ++i) free(c->entry[i].key);
+    free(c->entry);
+    free(c->bucket);
+}
+
+// Canonical text of an expression: its postfix tokens, so whitespace and
+// redundant parentheses are already gone, with the operands of commutative
+// operators in sorted order. "2+3", "3 + 2" and "(2)+3" all give "2 3 +".
+// Each stack slot is a segment of the text ending in a space; sorting two
+// operands rotates their adjacent segments. Returns a malloc'd string.
+char *canonical_key(const TokenList *postfix, size_t *len) {
+    static size_t start[MAX_TOKENS];
+    size_t cap = 1, n = 0;
+    int sp = 0;
+    for (int i = 0; i < postfix->count; ++i) cap += (postfix->items[i].op ? 2 : (size_t)postfix->items[i].len) + 1;
+    char *s = malloc(cap), *tmp = malloc(cap);
+    if (!s || !tmp) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int i = 0; i < postfix->count; ++i) {
+        const Token *t = &postfix->items[i];
+        if (!t->op) {
+            start[sp++] = n;
+            memcpy(s + n, t->text, (size_t)t->len);
+            n += (size_t)t->len;
+            s[n++] = ' ';
+            continue;
+        }
+        if (t->op != 'u' && sp >= 2) {
+            size_t a = start[sp - 2], b = start[sp - 1], la = b - a, lb = n - b;
+            int cmp = memcmp(s + a, s + b, la < lb ? la : lb);
+            if (strchr("+*en&|", t->op) && (cmp > 0 || (cmp == 0 && la > lb))) {
+                memcpy(tmp, s + a, la);
+                memmove(s + a, s + b, lb);
+                memcpy(s + a + lb, tmp, la);
+            }
+            sp--;
+        }
+        const char *text = operator_text(t->op);
+        size_t tl = strlen(text);
+        memcpy(s + n, text, tl);
+        n += tl;
+        s[n++] = ' ';
+    }
+    free(tmp);
+    if (n) n--;
+    s[n] = '\0';
+    *len = n;
+    return s;
+}
+
+// Cached result for key, or NULL.
+const char *result_cache_find(ResultCache *c, const char *key, size_t len, uint64_t hash) {
+    for (int i = c->bucket[hash & (uint64_t)(c->buckets - 1)]; i >= 0; i = c->entry[i].next) {
+        CacheEntry *e = &c->entry[i];
+        if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) {
+            e->referenced = 1;
+            c->hits++;
+            return e->value;
+        }
+    }
+    c->misses++;
+    return NULL;
+}
+
+static void result_cache_evict(ResultCache *c) {
+    for (;; c->hand = (c->hand + 1) % c->count) {
+        CacheEntry *e = &c->entry[c->hand];
+        if (!e->key) continue;
+        if (e->referenced) { e->referenced = 0; continue; }
+        int *link = &c->bucket[e->hash & (uint64_t)(c->buckets - 1)];
+        while (*link != c->hand) link = &c->entry[*link].next;
+        *link = e->next;
+        free(e->key);
+        e->key = NULL;
+        c->bytes -= e->size;
+        e->next = c->free;
+        c->free = c->hand;
+        c->evictions++;
+        c->hand = (c->hand + 1) % c->count;
+        return;
+    }
+}
+
+void result_cache_insert(ResultCache *c, const char *key, size_t len, uint64_t hash, const char *value) {
+    size_t vlen = strlen(value), size = len + vlen + 2;
+    if (!c->capacity || size > CACHE_MAX_BYTES) return;
+    while (c->bytes + size > CACHE_MAX_BYTES) result_cache_evict(c);
+    if (c->free < 0 && c->count == c->capacity) result_cache_evict(c);
+    int i = c->free >= 0 ? c->free : c->count++;
+    CacheEntry *e = &c->entry[i];
+    if (i == c->free) c->free = e->next;
+    if (!(e->key = malloc(size))) { fputs("Out of memory\n", stderr); exit(1); }
+    memcpy(e->key, key, len);
+    e->key[len] = '\0';
+    memcpy(e->key + len + 1, value, vlen + 1);
+    e->value = e->key + len + 1;
+    e->len = len;
+    e->size = size;
+    e->hash = hash;
+    e->referenced = 1;
+    e->next = c->bucket[hash & (uint64_t)(c->buckets - 1)];
+    c->bucket[hash & (uint64_t)(c->buckets - 1)] = i;
+    c->bytes += size;
+}
+
+// -------------------- Batch mode --------------------
+// --batch FORMULA reads one row per line from stdin, holding one integer per
+// formula variable (in order of first appearance), and prints one result or
+// error per row. A formula without variables ignores what the lines hold and
+// is evaluated once for each non-blank one.
+typedef struct {
+    long long *cols[MAX_VARS];
+    int ncols;
+    size_t rows, cap;
+} Table;
+
+static void table_grow(Table *t) {
+    t->cap = t->cap ? t->cap * 2 : 4096;
+    for (int k = 0; k < t->ncols; ++k) {
+        long long *c = realloc(t->cols[k], t->cap * sizeof(long long));
+        if (!c) { fputs("Out of memory\n", stderr); exit(1); }
+        t->cols[k] = c;
+    }
+}
+
+int table_read_rows(FILE *in, Table *t, char *err_msg) {
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t lineno = 0;
+
+    while (getline(&line, &line_cap, in) >= 0) {
+        char *p = line;
+        int k = 0;
+        lineno++;
+        if (t->rows == t->cap) table_grow(t);
+        if (!t->ncols) {
+            while (isspace((unsigned char)*p)) p++;
+            t->rows += *p != '\0';
+            continue;
+        }
+        while (1) {
+            while (isspace((unsigned char)*p)) p++;
+            if (!*p) break;
+            char *end;
+            errno = 0;
+            long long v = strtoll(p, &end, 10);
+            if (end == p || errno || (*end && !isspace((unsigned char)*end)) || k >= t->ncols) {
+                sprintf(err_msg, k >= t->ncols ? "Line %zu: expected %d values" : "Line %zu: invalid number", lineno, t->ncols);
+                free(line);
+                return 0;
+            }
+            t->cols[k++][t->rows] = v;
+            p = end;
+        }
+        if (k == 0) continue; // blank line
+        if (k != t->ncols) { sprintf(err_msg, "Line %zu: expected %d values", lineno, t->ncols); free(line); return 0; }
+        t->rows++;
+    }
+    free(line);
+    return 1;
+}
+
+// --aggregate LIST prints reductions of each formula over the kept rows
+// instead of the rows. Workers fold their blocks into partial aggregates, so
+// no per-row result is stored.
+static const char *agg_names[] = { "sum", "min", "max", "count", "avg" };
+enum { AGG_SUM = 1, AGG_MIN = 2, AGG_MAX = 4, AGG_COUNT = 8, AGG_AVG = 16 };
+
+// Bit set of the comma-separated aggregate names in list; 0 if one is unknown.
+int aggregate_parse(const char *list) {
+    int which = 0;
+    for (const char *p = list; *p; ) {
+        size_t len = strcspn(p, ","), k = 0;
+        while (k < 5 && !(strlen(agg_names[k]) == len && strncmp(agg_names[k], p, len) == 0)) k++;
+        if (k == 5) return 0;
+        which |= 1 << k;
+        p += len + (p[len] == ',');
+    }
+    return which;
+}
+
+static char *format_i128(__int128 v, char *end) {
+    unsigned __int128 m = v < 0 ? 0 - (unsigned __int128)v : (unsigned __int128)v;
+    do { *--end = (char)('0' + (int)(m % 10)); m /= 10; } while (m);
+    if (v < 0) *--end = '-';
+    return end;
+}
+
+// One line per requested aggregate with a column per formula, and a count of
+// the rows left out for errors if there were any. min, max and avg of no
+// rows are null.
+static void aggregate_print(int which, const ColAggregate *agg, int nout) {
+    size_t errors = 0;
+    double_tables_init();
+    for (int k = 0; k < 5; ++k) {
+        if (!(which & 1 << k)) continue;
+        fputs(agg_names[k], stdout);
+        for (int f = 0; f < nout; ++f) {
+            const ColAggregate *a = &agg[f];
+            char buf[48];
+            putchar('\t');
+            if (k == 0) { buf[47] = 0; fputs(format_i128(a->sum, buf + 47), stdout); }
+            else if (k == 3) printf("%zu", a->count);
+            else if (!a->count) fputs("null", stdout);
+            else if (k == 1) printf("%lld", a->min);
+            else if (k == 2) printf("%lld", a->max);
+            else {
+                // the quotient is exact; only the remainder's fraction rounds
+                __int128 q = a->sum / (__int128)a->count, r = a->sum % (__int128)a->count;
+                fputs(double_to_shortest((double)q + (double)r / (double)a->count, buf), stdout);
+            }
+        }
+        putchar('\n');
+    }
+    for (int f = 0; f < nout; ++f) errors += agg[f].errors;
+    if (!errors) return;
+    fputs("errors", stdout);
+    for (int f = 0; f < nout; ++f) printf("\t%zu", agg[f].errors);
+    putchar('\n');
+}
+
+// Points b's batches at zeroed aggregates when which asks for any.
+static void aggregate_begin(int which, ColumnBatch *b, ColAggregate *agg, int nout) {
+    for (int f = 0; which && f < nout; ++f) {
+        col_aggregate_init(&agg[f]);
+        b[f].agg = &agg[f];
+    }
+}
+
+// Scaling report: best of five runs for 1..num_threads threads.
+static void batch_bench(const FormulaSet *fs, const ColumnBatch *b) {
+    int max_threads = num_threads;
+    double base_time = 0;
+    printf("Rows: %zu, formulas: %d, kernels: %s\n", b->rows, fs->nout, simd_names[simd_level]);
+    printf("Threads  Time (ms)  Mrows/s  Speedup\n");
+    formula_set_evaluate(fs, b); // warm-up: first touch of the output pages
+    for (int t = 1; t <= max_threads; ++t) {
+        double best = 0;
+        num_threads = t;
+        for (int r = 0; r < 5; ++r) {
+            double start = now_seconds();
+            formula_set_evaluate(fs, b);
+            double el = now_seconds() - start;
+            if (r == 0 || el < best) best = el;
+        }
+        if (t == 1) base_time = best;
+        printf("%7d  %9.3f  %7.1f  %7.2f\n", t, best * 1e3, best > 0 ? (double)b->rows / best * 1e-6 : 0.0,
+               best > 0 ? base_time / best : 0.0);
+    }
+    num_threads = max_threads;
+}
+
+int run_batch(char *formula, const char *where, int aggregates, int bench) {
+    static FormulaSet fs;
+    static ColAggregate agg[MAX_FORMULAS];
+    char err[128] = {0};
+
+    if (!formula_set_compile(&fs, formula, where, err)) {
+        fprintf(stderr, "Error (formula): %s\n", err);
+        return 1;
+    }
+
+    Table t = { {0}, fs.nvars, 0, 0 };
+    if (!table_read_rows(stdin, &t, err)) {
+        fprintf(stderr, "Error (input): %s\n", err);
+        return 1;
+    }
+
+    ColumnBatch *b = column_batches_alloc(&fs, t.rows, (const long long **)t.cols);
+    aggregate_begin(aggregates, b, agg, fs.nout);
+    if (bench) {
+        batch_bench(&fs, b);
+    } else if (aggregates) {
+        formula_set_evaluate(&fs, b);
+        aggregate_print(aggregates, agg, fs.nout);
+    } else {
+        formula_set_evaluate(&fs, b);
+        for (size_t i = 0; i < t.rows; ++i) {
+            if (!columnar_row_selected(b, i)) continue;
+            for (int f = 0; f < fs.nout; ++f) {
+                int e = columnar_row_error(&b[f], i);
+                if (f) putchar('\t');
+                if (e >= 0) printf("Error: %s", col_err_names[e]);
+                else printf("%lld", b[f].out[i]);
+            }
+            putchar('\n');
+        }
+    }
+
+    column_batches_free(&fs, b);
+    formula_set_free(&fs);
+    for (int k = 0; k < t.ncols; ++k) free(t.cols[k]);
+    return 0;
+}
+
+// -------------------- Delimited text input --------------------
+// --batch FORMULA --csv FILE (or --tsv FILE) binds header names to the
+// formula's variables and prints the file back with a "result" column
+// appended ("result1", "result2", ... for several formulas). Only
+// referenced columns are parsed: delimiters are found 64 bytes at a time
+// with delim_mask and integers with an 8-digits-at-a-time parser. Rows are
+// evaluated CSV_BLOCK_ROWS at a time. Fields are not quoted.
+#define CSV_BLOCK_ROWS (64 * COL_BLOCK)
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+static inline int swar_all_digits(uint64_t x) {
+    return ((x & 0xF0F0F0F0F0F0F0F0ULL) | (((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+           == 0x3333333333333333ULL;
+}
+
+// Eight ASCII digits (first digit in the low byte) to their value.
+static inline uint64_t swar_eight_digits(uint64_t x) {
+    x = (x & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    x = (x & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (x & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+#endif
+
+// Field [s, e) as an optionally signed integer; 0 if it is not one or overflows.
+static int parse_ll(const char *s, const char *e, long long *out) {
+    int neg = 0;
+    if (s < e && (*s == '-' || *s == '+')) neg = *s++ == '-';
+    size_t n = (size_t)(e - s);
+    if (n == 0 || n > 19) return 0; // 19 digits cannot overflow a uint64_t
+    uint64_t v = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; n >= 8; n -= 8, s += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, s, 8);
+        if (!swar_all_digits(chunk)) return 0;
+        v = v * 100000000 + swar_eight_digits(chunk);
+    }
+#endif
+    for (; n; --n, ++s) {
+        unsigned d = (unsigned)(*s - '0');
+        if (d > 9) return 0;
+        v = v * 10 + d;
+    }
+    if (v > (uint64_t)LLONG_MAX + (uint64_t)neg) return 0;
+    *out = neg ? (long long)(0ULL - v) : (long long)v;
+    return 1;
+}
+
+// Digits of v ending just before end; returns the first character.
+static char *format_ll(long long v, char *end) {
+    unsigned long long m = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do { *--end = (char)('0' + m % 10); m /= 10; } while (m);
+    if (v < 0) *--end = '-';
+    return end;
+}
+
+typedef struct {
+    const char *data;      // whole file, ending in '\n' and followed by 64 zero bytes
+    size_t len;
+    char delim;
+    int nfields;           // header width
+    int field_var[MAX_TOKENS]; // header field -> program variable, or -1
+    size_t line;           // current line number, for messages
+} CsvReader;
+
+// Whole file (or stdin for "-") with the padding delim_mask needs; *size,
+// if not NULL, gets the number of bytes read before a final '\n' was added.
+static char *read_whole_file(const char *path, size_t *len, size_t *size) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 1 << 16, n = 0;
+    char *buf = malloc(cap + 65);
+    while (buf) {
+        n += fread(buf + n, 1, cap - n, f);
+        if (n < cap) break;
+        cap *= 2;
+        char *grown = realloc(buf, cap + 65);
+        if (!grown) { free(buf); buf = NULL; }
+        buf = grown;
+    }
+    if (f != stdin) fclose(f);
+    if (!buf) { fputs("Out of memory\n", stderr); exit(1); }
+    if (size) *size = n;
+    if (n == 0 || buf[n - 1] != '\n') buf[n++] = '\n';
+    memset(buf + n, 0, 64);
+    *len = n;
+    return buf;
+}
+
+static int csv_read_header(CsvReader *r, const FormulaSet *prog, size_t *pos, char *err_msg) {
+    const char *p = r->data, *line_end = memchr(p, '\n', r->len);
+    int found[MAX_VARS] = { 0 };
+    r->nfields = 0;
+    while (1) {
+        const char *e = p;
+        while (e < line_end && *e != r->delim) e++;
+        const char *fe = (e == line_end && e > p && e[-1] == '\r') ? e - 1 : e;
+        if (r->nfields >= MAX_TOKENS) { strcpy(err_msg,"Too many columns"); return 0; }
+        int v = -1;
+        for (int k = 0; k < prog->nvars; ++k)
+            if (prog->var_len[k] == fe - p && memcmp(prog->var_name[k], p, (size_t)(fe - p)) == 0) v = k;
+        if (v >= 0) found[v] = 1;
+        r->field_var[r->nfields++] = v;
+        if (e == line_end) break;
+        p = e + 1;
+    }
+    for (int k = 0; k < prog->nvars; ++k) {
+        if (!found[k]) {
+            snprintf(err_msg, 128, "Column '%.*s' not found in header", prog->var_len[k] > 80 ? 80 : prog->var_len[k], prog->var_name[k]);
+            return 0;
+        }
+    }
+    *pos = (size_t)(line_end - r->data) + 1;
+    r->line = 1;
+    return 1;
+}
+
+// Parses up to max_rows rows from pos into cols. row_start/row_end delimit
+// each line (without "\r\n"); bad marks rows whose referenced fields are not
+// integers. Returns the position after the last row, or 0 on a malformed line.
+static size_t csv_parse_rows(CsvReader *r, size_t pos, size_t max_rows, long long **cols,
+                             size_t *row_start, size_t *row_end, uint64_t *bad, size_t *nrows, char *err_msg) {
+    size_t rows = 0, field_start = pos;
+    int field = 0;
+    memset(bad, 0, (max_rows + 63) / 64 * sizeof(uint64_t));
+    row_start[0] = pos;
+
+    for (size_t chunk = pos; chunk < r->len; chunk += 64) {
+        uint64_t m = delim_mask(r->data + chunk, r->delim);
+        while (m) {
+            size_t at = chunk + (size_t)__builtin_ctzll(m);
+            m &= m - 1;
+            int is_nl = r->data[at] == '\n';
+            size_t end = (is_nl && at > field_start && r->data[at - 1] == '\r') ? at - 1 : at;
+
+            if (is_nl && field == 0 && end == field_start) { // blank line
+                r->line++;
+                field_start = row_start[rows] = at + 1;
+                continue;
+            }
+            int v = field < r->nfields ? r->field_var[field] : -1;
+            if (v >= 0 && !parse_ll(r->data + field_start, r->data + end, &cols[v][rows])) {
+                cols[v][rows] = 0;
+                bad[rows / 64] |= 1ULL << (rows % 64);
+            }
+            field_start = at + 1;
+            if (!is_nl) { field++; continue; }
+
+            r->line++;
+            if (field + 1 != r->nfields) {
+                sprintf(err_msg, "Line %zu: expected %d fields", r->line, r->nfields);
+                return 0;
+            }
+            row_end[rows++] = end;
+            field = 0;
+            if (rows == max_rows) { *nrows = rows; return at + 1; }
+            row_start[rows] = at + 1;
+        }
+    }
+    *nrows = rows;
+    return r->len;
+}
+
+int run_delimited(char *formula, const char *where, int aggregates, const char *path, char delim) {
+    static FormulaSet fs;
+    static ColAggregate agg[MAX_FORMULAS];
+    static CsvReader r;
+    char err[128] = {0};
+    size_t pos;
+
+    if (!formula_set_compile(&fs, formula, where, err)) {
+        fprintf(stderr, "Error (formula): %s\n", err);
+        return 1;
+    }
+    r.data = read_whole_file(path, &r.len, NULL);
+    r.delim = delim;
+    if (!r.data) { fprintf(stderr, "Error (input): cannot read %s\n", path); return 1; }
+    if (!csv_read_header(&r, &fs, &pos, err)) {
+        fprintf(stderr, "Error (input): %s\n", err);
+        free((char *)r.data);
+        return 1;
+    }
+
+    long long *cols[MAX_VARS];
+    size_t *row_start = malloc(CSV_BLOCK_ROWS * sizeof(size_t));
+    size_t *row_end = malloc(CSV_BLOCK_ROWS * sizeof(size_t));
+    uint64_t *bad = malloc(CSV_BLOCK_ROWS / 64 * sizeof(uint64_t));
+    for (int k = 0; k < fs.nvars; ++k) if (!(cols[k] = malloc(CSV_BLOCK_ROWS * sizeof(long long)))) bad = NULL;
+    if (!row_start || !row_end || !bad) { fputs("Out of memory\n", stderr); exit(1); }
+    ColumnBatch *b = column_batches_alloc(&fs, CSV_BLOCK_ROWS, (const long long **)cols);
+    aggregate_begin(aggregates, b, agg, fs.nout);
+    for (int f = 0; aggregates && f < fs.nout; ++f) b[f].skip = bad;
+
+    // header line plus the new columns
+    const char *hdr_end = r.data + pos - 1;
+    if (hdr_end > r.data && hdr_end[-1] == '\r') hdr_end--;
+    if (!aggregates) {
+        fwrite(r.data, 1, (size_t)(hdr_end - r.data), stdout);
+        if (fs.nout == 1) printf("%cresult", delim);
+        else for (int f = 0; f < fs.nout; ++f) printf("%cresult%d", delim, f + 1);
+        putchar('\n');
+    }
+
+    int status = 0;
+    while (pos < r.len) {
+        size_t rows;
+        pos = csv_parse_rows(&r, pos, CSV_BLOCK_ROWS, cols, row_start, row_end, bad, &rows, err);
+        if (!pos) { fprintf(stderr, "Error (input): %s\n", err); status = 1; break; }
+        for (int f = 0; f < fs.nout; ++f) b[f].rows = rows;
+        formula_set_evaluate(&fs, b);
+
+        for (size_t i = 0; !aggregates && i < rows; ++i) {
+            int is_bad = (bad[i / 64] >> (i % 64)) & 1;
+            if (!columnar_row_selected(b, i) || (is_bad && fs.nconj)) continue;
+            fwrite(r.data + row_start[i], 1, row_end[i] - row_start[i], stdout);
+            for (int f = 0; f < fs.nout; ++f) {
+                char num[24], *digits = num;
+                int e = columnar_row_error(&b[f], i);
+                putchar(delim);
+                if (is_bad) fputs("Error: Invalid number in input", stdout);
+                else if (e >= 0) printf("Error: %s", col_err_names[e]);
+                else { digits = format_ll(b[f].out[i], num + sizeof(num)); fwrite(digits, 1, (size_t)(num + sizeof(num) - digits), stdout); }
+            }
+            putchar('\n');
+        }
+    }
+
+    if (aggregates && !status) aggregate_print(aggregates, agg, fs.nout);
+    column_batches_free(&fs, b);
+    formula_set_free(&fs);
+    for (int k = 0; k < fs.nvars; ++k) free(cols[k]);
+    free(bad);
+    free(row_end);
+    free(row_start);
+    free((char *)r.data);
+    return status;
+}
+
+// -------------------- Expression files --------------------
+// --lines FILE evaluates every line of FILE (or stdin for "-") as an integer
+// expression and prints one result or error per line, with the same
+// semantics as --batch. Lines that differ only in their literals share a
+// shape: the line's tokens with each literal replaced by '#', the literals
+// being the shape's parameters. A shape is compiled once, with parameter k
+// as variable k, and the lines of a block that share it are evaluated
+// together as the rows of one columnar batch, so a line costs a scan and a
+// hash lookup instead of a parse. Lines the scan cannot reduce to literals,
+// operators and parentheses (variables, decimal or oversized literals, more
+// than MAX_VARS literals, stray characters) are compiled on their own.
+#define LINES_BLOCK (64 * COL_BLOCK) // lines scanned before their shapes are evaluated
+
+typedef struct {
+    char *key;                     // operator codes, parentheses and '#' per literal
+    int len;
+    uint64_t hash;
+    Instr *code;                   // NULL if the shape failed to compile
+    int count, nparams, depth;
+    char err[128];                 // why it failed
+    long long *param[MAX_VARS];    // the block's lines, one column per parameter
+    size_t rows, cap;
+    ColumnBatch b;
+} Shape;
+
+typedef struct {
+    Shape **shape;
+    size_t count, cap;
+    int *slot;                     // open addressing into shape, -1 if empty
+    size_t slots;                  // a power of two, kept at least twice count
+} ShapeTable;
+
+// Reduces line to its shape key (at most MAX_TOKENS bytes) and its literals;
+// returns the key length, or -1 for a line that has to be compiled alone.
+// Letters are rejected before operators, as in the lexer, so the letter
+// codes of two-character operators cannot come from the text.
+static int shape_scan(const char *s, char *key, long long *param, int *nparams, uint64_t *hash) {
+    int len = 0, n = 0;
+    uint64_t h = 0;
+    while (*s) {
+        char c;
+        int op_len;
+        if (isspace((unsigned char)*s)) { s++; continue; }
+        if (len == MAX_TOKENS) return -1;
+        if (isdigit((unsigned char)*s)) {
+            unsigned long long v = 0;
+            for (; isdigit((unsigned char)*s); ++s) {
+                if (v > (unsigned long long)(LLONG_MAX - (*s - '0')) / 10) return -1;
+                v = v * 10 + (unsigned)(*s - '0');
+            }
+            if (*s == '.' || isalnum((unsigned char)*s) || *s == '_' || n == MAX_VARS) return -1;
+            param[n++] = (long long)v;
+            c = '#';
+        } else if (*s == '(' || *s == ')') {
+            c = *s++;
+        } else if (!isalpha((unsigned char)*s) && *s != '_' && (op_len = scan_operator(s, &c))) {
+            s += op_len;
+        } else {
+            return -1;
+        }
+        key[len++] = c;
+        h = (h ^ (unsigned char)c) * 0x9E3779B97F4A7C15ULL;
+    }
+    *nparams = n;
+    *hash = h;
+    return len;
+}
+
+// Spells the key out with parameter k as variable _k and compiles it. The
+// tokens are space-separated so that neither operators nor parameters run
+// together into different tokens.
+static void shape_compile(Shape *sh) {
+    static char text[4 * MAX_TOKENS + 1];
+    static TokenList postfix;
+    static Program prog;
+    char *p = text;
+    for (int i = 0, k = 0; i < sh->len; ++i) {
+        char c = sh->key[i];
+        if (c == '#') p += sprintf(p, "_%d ", k++);
+        else if (c == '(' || c == ')') p += sprintf(p, "%c ", c);
+        else p += sprintf(p, "%s ", operator_text(c));
+    }
+    *p = '\0';
+    sh->code = NULL;
+    if (!batch_compile(text, &postfix, &prog, sh->err)) return;
+    sh->code = malloc((size_t)(prog.count ? prog.count : 1) * sizeof(Instr));
+    if (!sh->code) { fputs("Out of memory\n", stderr); exit(1); }
+    memcpy(sh->code, prog.code, (size_t)prog.count * sizeof(Instr));
+    sh->count = prog.count;
+    sh->depth = prog.depth;
+}
+
+static Shape *shape_find(ShapeTable *t, const char *key, int len, int nparams, uint64_t hash) {
+    if (2 * (t->count + 1) > t->slots) {
+        t->slots = t->slots ? t->slots * 2 : 1024;
+        free(t->slot);
+        t->slot = malloc(t->slots * sizeof(int));
+        if (!t->slot) { fputs("Out of memory\n", stderr); exit(1); }
+        for (size_t i = 0; i < t->slots; ++i) t->slot[i] = -1;
+        for (size_t k = 0; k < t->count; ++k) {
+            size_t i = (size_t)(t->shape[k]->hash >> 32) & (t->slots - 1);
+            while (t->slot[i] >= 0) i = (i + 1) & (t->slots - 1);
+            t->slot[i] = (int)k;
+        }
+    }
+    size_t i = (size_t)(hash >> 32) & (t->slots - 1);
+    for (; t->slot[i] >= 0; i = (i + 1) & (t->slots - 1)) {
+        Shape *sh = t->shape[t->slot[i]];
+        if (sh->hash == hash && sh->len == len && memcmp(sh->key, key, (size_t)len) == 0) return sh;
+    }
+    if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 256;
+        Shape **grown = realloc(t->shape, t->cap * sizeof(Shape *));
+        if (!grown) { fputs("Out of memory\n", stderr); exit(1); }
+        t->shape = grown;
+    }
+    Shape *sh = calloc(1, sizeof(Shape));
+    if (!sh || !(sh->key = malloc((size_t)len + 1))) { fputs("Out of memory\n", stderr); exit(1); }
+    memcpy(sh->key, key, (size_t)len);
+    sh->len = len;
+    sh->hash = hash;
+    sh->nparams = nparams;
+    shape_compile(sh);
+    t->slot[i] = (int)t->count;
+    t->shape[t->count++] = sh;
+    return sh;
+}
+
+// Appends one line's parameters to sh; returns its row.
+static size_t shape_add_row(Shape *sh, const long long *param) {
+    if (sh->rows == sh->cap) {
+        sh->cap = sh->cap ? sh->cap * 2 : 64;
+        for (int k = 0; k < sh->nparams; ++k) {
+            long long *c = realloc(sh->param[k], sh->cap * sizeof(long long));
+            if (!c) { fputs("Out of memory\n", stderr); exit(1); }
+            sh->param[k] = c;
+        }
+    }
+    for (int k = 0; k < sh->nparams; ++k) sh->param[k][sh->rows] = param[k];
+    return sh->rows++;
+}
+
+static void shape_evaluate(Shape *sh) {
+    static Program prog;
+    column_batch_alloc(&sh->b, sh->rows);
+    sh->b.cols = (const long long **)sh->param;
+    if (!sh->code) return;
+    memcpy(prog.code, sh->code, (size_t)sh->count * sizeof(Instr));
+    prog.count = sh->count;
+    prog.nvars = sh->nparams;
+    prog.depth = sh->depth;
+    columnar_evaluate(&prog, &sh->b);
+}
+
+// Result of a line that has no shape, as it is printed.
+static void line_alone(const char *line, char *text, size_t size) {
+    static TokenList postfix;
+    static Program prog;
+    char err[128] = {0};
+    if (!batch_compile(line, &postfix, &prog, err)) { snprintf(text, size, "Error: %s", err); return; }
+    if (prog.nvars) { snprintf(text, size, "Error: Variables need --batch"); return; }
+    ColumnBatch b;
+    column_batch_alloc(&b, 1);
+    b.cols = NULL;
+    columnar_evaluate(&prog, &b);
+    int e = columnar_row_error(&b, 0);
+    if (e >= 0) snprintf(text, size, "Error: %s", col_err_names[e]);
+    else snprintf(text, size, "%lld", b.out[0]);
+    column_batch_free(&b);
+}
+
+int run_lines(const char *path) {
+    static ShapeTable t;
+    static char key[MAX_TOKENS];
+    static Shape *line_shape[LINES_BLOCK]; // NULL for a line evaluated alone
+    static size_t line_row[LINES_BLOCK];   // row in its shape, or index into alone
+    char (*alone)[160] = NULL;
+    size_t alone_cap = 0, len, size;
+    Shape **used = NULL;
+    size_t used_cap = 0;
+
+    char *data = read_whole_file(path, &len, &size);
+    if (!data) { fprintf(stderr, "Error (input): cannot read %s\n", path); return 1; }
+    char *p = data, *end = data + (size ? len : 0); // an empty file has no lines
+    while (p < end) {
+        size_t lines = 0, nalone = 0, nused = 0;
+        for (; lines < LINES_BLOCK && p < end; ++lines) {
+            char *nl = memchr(p, '\n', (size_t)(end - p));
+            long long param[MAX_VARS];
+            int nparams;
+            uint64_t hash;
+            *nl = '\0';
+            int klen = shape_scan(p, key, param, &nparams, &hash);
+            if (klen < 0) {
+                if (nalone == alone_cap) {
+                    alone_cap = alone_cap ? alone_cap * 2 : 64;
+                    alone = realloc(alone, alone_cap * sizeof(*alone));
+                    if (!alone) { fputs("Out of memory\n", stderr); exit(1); }
+                }
+                line_alone(p, alone[nalone], sizeof(alone[0]));
+                line_shape[lines] = NULL;
+                line_row[lines] = nalone++;
+            } else if (klen > 0) {
+                Shape *sh = shape_find(&t, key, klen, nparams, hash);
+                if (!sh->rows) {
+                    if (nused == used_cap) {
+                        used_cap = used_cap ? used_cap * 2 : 64;
+                        used = realloc(used, used_cap * sizeof(Shape *));
+                        if (!used) { fputs("Out of memory\n", stderr); exit(1); }
+                    }
+                    used[nused++] = sh;
+                }
+                line_shape[lines] = sh;
+                line_row[lines] = shape_add_row(sh, param);
+            } else {
+                line_shape[lines] = NULL;
+                line_row[lines] = (size_t)-1; // blank line, printed blank
+            }
+            p = nl + 1;
+        }
+
+        for (size_t u = 0; u < nused; ++u) shape_evaluate(used[u]);
+        for (size_t i = 0; i < lines; ++i) {
+            const Shape *sh = line_shape[i];
+            if (!sh) {
+                if (line_row[i] != (size_t)-1) fputs(alone[line_row[i]], stdout);
+            } else if (!sh->code) {
+                printf("Error: %s", sh->err);
+            } else {
+                int e = columnar_row_error(&sh->b, line_row[i]);
+                if (e >= 0) printf("Error: %s", col_err_names[e]);
+                else printf("%lld", sh->b.out[line_row[i]]);
+            }
+            putchar('\n');
+        }
+        for (size_t u = 0; u < nused; ++u) {
+            column_batch_free(&used[u]->b);
+            used[u]->rows = 0;
+        }
+    }
+
+    for (size_t k = 0; k < t.count; ++k) {
+        for (int j = 0; j < t.shape[k]->nparams; ++j) free(t.shape[k]->param[j]);
+        free(t.shape[k]->code);
+        free(t.shape[k]->key);
+        free(t.shape[k]);
+    }
+    free(t.shape);
+    free(t.slot);
+    free(used);
+    free(alone);
+    free(data);
+    return 0;
+}
+
+// -------------------- Column files --------------------
+// A column file stores a table as raw little-endian arrays so it can be
+// mmapped and evaluated with no parsing and no copies:
+//   [0, 64)      ColFileHeader
+//   [64, ...)    one 64-byte ColFileEntry per column
+//   then each column's values (rows * 8 bytes) and optional validity bitmap
+//   ((rows + 63) / 64 words, bit set = value present), every array starting
+//   at a 64-byte aligned offset.
+// Dictionary and run-length encoded int64 columns point data at a
+// ColFileEncoding instead, which locates the dictionary (or run values) and
+// the per-row uint32 codes (or the uint64 end row of each run).
+// --batch FORMULA --columns FILE binds variables to columns by name. int64
+// columns are read in place; double columns are converted and must hold
+// integers. --out FILE writes the results as a column file with one int64
+// column "result" whose validity bitmap clears null inputs and error rows.
+#define COLFILE_MAGIC "EXCOLS1"
+#define COLFILE_ALIGN(x) (((x) + 63) & ~(uint64_t)63)
+
+enum { COLFILE_INT64 = 1, COLFILE_DOUBLE = 2, COLFILE_DICT = 3, COLFILE_RLE = 4 };
+
+typedef struct {
+    char magic[8];                 // COLFILE_MAGIC
+    uint64_t rows;
+    uint32_t ncols;
+    uint8_t reserved[44];
+} ColFileHeader;
+
+typedef struct {
+    char name[40];                 // NUL-padded
+    uint8_t type;                  // COLFILE_*
+    uint8_t reserved[7];
+    uint64_t data;                 // offset of the values
+    uint64_t validity;             // offset of the validity bitmap, or 0 if none
+} ColFileEntry;
+
+typedef struct {
+    uint64_t n;                    // dictionary size or run count
+    uint64_t values;               // offset of n int64 values
+    uint64_t index;                // offset of rows uint32 codes, or of n uint64 run ends
+    uint8_t reserved[40];
+} ColFileEncoding;
+
+_Static_assert(sizeof(ColFileHeader) == 64 && sizeof(ColFileEntry) == 64 && sizeof(ColFileEncoding) == 64,
+               "column file layout");
+
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    const ColFileHeader *hdr;
+    const ColFileEntry *cols;
+} ColFile;
+
+static int colfile_range_ok(const ColFile *f, uint64_t off, uint64_t bytes) {
+    return off % 64 == 0 && off >= 64 && off <= f->size && bytes <= f->size - off;
+}
+
+int colfile_open(const char *path, ColFile *f, char *err_msg) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        sprintf(err_msg, "Cannot read %.80s", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    f->size = (size_t)st.st_size;
+    f->base = f->size >= sizeof(ColFileHeader) ? mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (f->base == MAP_FAILED || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+        || memcmp(f->base, COLFILE_MAGIC, sizeof(COLFILE_MAGIC)) != 0) {
+        if (f->base != MAP_FAILED) munmap(f->base, f->size);
+        sprintf(err_msg, "%.80s is not a column file", path);
+        return 0;
+    }
+    f->hdr = (const ColFileHeader *)f->base;
+    f->cols = (const ColFileEntry *)(f->base + sizeof(ColFileHeader));
+
+    uint64_t rows = f->hdr->rows, words = (rows + 63) / 64;
+    int ok = f->hdr->ncols <= (f->size - sizeof(ColFileHeader)) / sizeof(ColFileEntry) && rows < (1ULL << 62);
+    for (uint32_t k = 0; ok && k < f->hdr->ncols; ++k) {
+        const ColFileEntry *c = &f->cols[k];
+        const ColFileEncoding *enc = (const ColFileEncoding *)(f->base + c->data);
+        ok = c->validity == 0 || colfile_range_ok(f, c->validity, words * 8);
+        if (c->type == COLFILE_INT64 || c->type == COLFILE_DOUBLE)
+            ok = ok && rows <= f->size / 8 && colfile_range_ok(f, c->data, rows * 8);
+        else if (c->type == COLFILE_DICT || c->type == COLFILE_RLE)
+            ok = ok && colfile_range_ok(f, c->data, sizeof(ColFileEncoding)) && enc->n <= f->size / 8
+                 && colfile_range_ok(f, enc->values, enc->n * 8)
+                 && (c->type == COLFILE_DICT ? rows <= f->size / 4 && colfile_range_ok(f, enc->index, rows * 4)
+                                             : colfile_range_ok(f, enc->index, enc->n * 8));
+        else ok = 0;
+    }
+    if (!ok) {
+        munmap(f->base, f->size);
+        sprintf(err_msg, "%.80s is truncated or corrupt", path);
+        return 0;
+    }
+    madvise(f->base, f->size, MADV_SEQUENTIAL);
+    return 1;
+}
+
+static const ColFileEntry *colfile_find(const ColFile *f, const char *name, int len) {
+    for (uint32_t k = 0; k < f->hdr->ncols; ++k) {
+        const ColFileEntry *c = &f->cols[k];
+        if (len <= (int)sizeof(c->name) && strncmp(c->name, name, (size_t)len) == 0
+            && (len == (int)sizeof(c->name) || c->name[len] == '\0'))
+            return c;
+    }
+    return NULL;
+}
+
+// Creates path as a file of ncols result columns, mapped for writing, and
+// points values[k] and validity[k] into it.
+static int colfile_create_results(const char *path, size_t rows, int ncols, ColFile *f, long long **values,
+                                  uint64_t **validity, char *err_msg) {
+    uint64_t data_size = COLFILE_ALIGN((uint64_t)rows * 8), valid_size = COLFILE_ALIGN((rows + 63) / 64 * 8);
+    uint64_t first = 64 + COLFILE_ALIGN((uint64_t)ncols * 64);
+    f->size = (size_t)(first + (data_size + valid_size) * (uint64_t)ncols);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)f->size) < 0
+        || (f->base = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        sprintf(err_msg, "Cannot write %.80s", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    close(fd);
+
+    ColFileHeader *h = (ColFileHeader *)f->base;
+    memcpy(h->magic, COLFILE_MAGIC, sizeof(COLFILE_MAGIC));
+    h->rows = rows;
+    h->ncols = (uint32_t)ncols;
+    for (int k = 0; k < ncols; ++k) {
+        ColFileEntry *c = (ColFileEntry *)(f->base + sizeof(ColFileHeader)) + k;
+        if (ncols == 1) strcpy(c->name, "result");
+        else sprintf(c->name, "result%d", k + 1);
+        c->type = COLFILE_INT64;
+        c->data = first + (data_size + valid_size) * (uint64_t)k;
+        c->validity = c->data + data_size;
+        values[k] = (long long *)(f->base + c->data);
+        validity[k] = (uint64_t *)(f->base + c->validity);
+    }
+    return 1;
+}
+
+// Doubles as int64s; rows that are not integers are marked in bad. NULL if
+// out of memory.
+static long long *doubles_to_ll(const double *d, size_t rows, uint64_t *bad) {
+    long long *v = malloc((rows + 1) * sizeof(long long));
+    if (!v) return NULL;
+    for (size_t i = 0; i < rows; ++i) {
+        int ok = d[i] >= -0x1p63 && d[i] < 0x1p63 && d[i] == (double)(long long)d[i];
+        v[i] = ok ? (long long)d[i] : 0;
+        bad[i / 64] |= (uint64_t)!ok << (i % 64);
+    }
+    return v;
+}
+
+// Rows whose bound input is null (missing) or a double that is not an
+// integer (bad) become bitmaps, and out receives the int64 view of the
+// column. 0 if its encoding is inconsistent.
+static int colfile_bind(const ColFile *f, const ColFileEntry *c, uint64_t *missing, uint64_t *bad, EncodedColumn *out) {
+    size_t rows = f->hdr->rows, words = (rows + 63) / 64;
+    const ColFileEncoding *enc = (const ColFileEncoding *)(f->base + c->data);
+    if (c->validity) {
+        const uint64_t *v = (const uint64_t *)(f->base + c->validity);
+        for (size_t w = 0; w < words; ++w) missing[w] |= ~v[w];
+    }
+    out->kind = ENC_PLAIN;
+    switch (c->type) {
+        case COLFILE_INT64:
+            out->values = (const long long *)(f->base + c->data);
+            return 1;
+        case COLFILE_DOUBLE:
+            out->values = doubles_to_ll((const double *)(f->base + c->data), rows, bad);
+            if (!out->values) { fputs("Out of memory\n", stderr); exit(1); }
+            return 1;
+    }
+
+    // Encoded: check that every code or run end is in range before trusting it
+    uint32_t max_code = 0;
+    out->values = (const long long *)(f->base + enc->values);
+    out->n = enc->n;
+    if (c->type == COLFILE_DICT) {
+        out->kind = ENC_DICT;
+        out->codes = (const uint32_t *)(f->base + enc->index);
+        for (size_t i = 0; i < rows; ++i) max_code = out->codes[i] > max_code ? out->codes[i] : max_code;
+        return rows == 0 || max_code < enc->n;
+    }
+    out->kind = ENC_RLE;
+    out->ends = (const uint64_t *)(f->base + enc->index);
+    for (size_t k = 0; k < enc->n; ++k)
+        if (out->ends[k] <= (k ? out->ends[k - 1] : 0)) return 0;
+    return enc->n ? out->ends[enc->n - 1] == rows : rows == 0;
+}
+
+int run_columns(char *formula, const char *where, int aggregates, const char *path, const char *out_path, int bench) {
+    static FormulaSet fs;
+    static ColAggregate agg[MAX_FORMULAS];
+    static long long *values[MAX_FORMULAS];
+    static uint64_t *validity[MAX_FORMULAS];
+    EncodedColumn enc[MAX_VARS];
+    EncodedPlan plan;
+    ColFile in, out;
+    char err[128] = {0};
+
+    if (!formula_set_compile(&fs, formula, where, err)) {
+        fprintf(stderr, "Error (formula): %s\n", err);
+        return 1;
+    }
+    if (!colfile_open(path, &in, err)) {
+        fprintf(stderr, "Error (input): %s\n", err);
+        return 1;
+    }
+
+    size_t rows = in.hdr->rows, words = (rows + 63) / 64;
+    const ColFileEntry *entry[MAX_VARS];
+    uint64_t *missing = calloc(words + 1, sizeof(uint64_t)), *bad = calloc(words + 1, sizeof(uint64_t));
+    if (!missing || !bad) { fputs("Out of memory\n", stderr); exit(1); }
+    for (int k = 0; k < fs.nvars; ++k) {
+        int len = fs.var_len[k] > 80 ? 80 : fs.var_len[k];
+        if (!(entry[k] = colfile_find(&in, fs.var_name[k], fs.var_len[k]))) {
+            fprintf(stderr, "Error (input): Column '%.*s' not found\n", len, fs.var_name[k]);
+            munmap(in.base, in.size);
+            return 1;
+        }
+        if (!colfile_bind(&in, entry[k], missing, bad, &enc[k])) {
+            fprintf(stderr, "Error (input): Column '%.*s' has an invalid encoding\n", len, fs.var_name[k]);
+            munmap(in.base, in.size);
+            return 1;
+        }
+    }
+    if (!encoded_plan(&plan, enc, fs.nvars, rows)) { fputs("Out of memory\n", stderr); exit(1); }
+
+    // Without a predicate the kernels of a plain plan write straight into the
+    // output file; with one its size is known only after evaluation.
+    ColumnBatch *b = column_batches_alloc(&fs, plan.n, plan.cols);
+    int direct = out_path && plan.kind == ENC_PLAIN && !fs.nconj;
+    uint64_t *skip = NULL;
+    if (aggregates && plan.kind == ENC_PLAIN) { // folded by the workers; other plans afterwards
+        skip = malloc((words + 1) * sizeof(uint64_t));
+        if (!skip) { fputs("Out of memory\n", stderr); exit(1); }
+        for (size_t w = 0; w <= words; ++w) skip[w] = missing[w] | bad[w];
+        aggregate_begin(aggregates, b, agg, fs.nout);
+        for (int f = 0; f < fs.nout; ++f) b[f].skip = skip;
+    }
+    if (direct) {
+        if (!colfile_create_results(out_path, rows, fs.nout, &out, values, validity, err)) {
+            fprintf(stderr, "Error (output): %s\n", err);
+            return 1;
+        }
+        for (int f = 0; f < fs.nout; ++f) {
+            free(b[f].out);
+            b[f].out = values[f];
+        }
+    }
+
+    if (bench) batch_bench(&fs, b);
+    else formula_set_evaluate(&fs, b);
+
+    if (aggregates && !bench) {
+        for (int f = 0; plan.kind != ENC_PLAIN && f < fs.nout; ++f) {
+            col_aggregate_init(&agg[f]);
+            encoded_aggregate(&plan, &b[f], rows, missing, bad, &agg[f]);
+        }
+        aggregate_print(aggregates, agg, fs.nout);
+    } else if (out_path) {
+        size_t kept = encoded_selected_rows(&plan, b, rows, missing, bad);
+        if (!direct && !colfile_create_results(out_path, kept, fs.nout, &out, values, validity, err)) {
+            fprintf(stderr, "Error (output): %s\n", err);
+            return 1;
+        }
+        for (int f = 0; f < fs.nout; ++f) {
+            encoded_expand(&plan, &b[f], rows, missing, bad, values[f], validity[f]);
+            if (direct) b[f].out = NULL;
+        }
+        munmap(out.base, out.size);
+    } else if (!bench) {
+        char num[24], *digits;
+        size_t run = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            size_t j = encoded_row(&plan, i, &run);
+            if (!encoded_row_selected(b, i, j, missing, bad)) continue;
+            for (int f = 0; f < fs.nout; ++f) {
+                int e = columnar_row_error(&b[f], j);
+                if (f) putchar('\t');
+                if ((missing[i / 64] >> (i % 64)) & 1) fputs("null", stdout);
+                else if ((bad[i / 64] >> (i % 64)) & 1) fputs("Error: Invalid number in input", stdout);
+                else if (e >= 0) printf("Error: %s", col_err_names[e]);
+                else { digits = format_ll(b[f].out[j], num + sizeof(num)); fwrite(digits, 1, (size_t)(num + sizeof(num) - digits), stdout); }
+            }
+            putchar('\n');
+        }
+    }
+
+    column_batches_free(&fs, b);
+    formula_set_free(&fs);
+    encoded_plan_free(&plan);
+    for (int k = 0; k < fs.nvars; ++k) if (entry[k]->type == COLFILE_DOUBLE) free((long long *)enc[k].values);
+    free(skip);
+    free(bad);
+    free(missing);
+    munmap(in.base, in.size);
+    return 0;
+}
+
+// -------------------- Arrow C Data Interface --------------------
+// Programs that already hold Arrow data evaluate it in-process with
+// arrow_evaluate(): the input is a struct array (format "+s", e.g. an exported
+// record batch) whose children bind to formula variables by name. int64 ("l")
+// children are read in place and float64 ("g") children are converted and
+// must hold integers. Dictionary-encoded children (int32 indices into int64
+// values) and run-end encoded ones ("+r" with int64 values) are evaluated
+// per value or run (see "Compressed execution"). The result is exported as
+// a nullable int64 array "result", written by the kernels in place for
+// plain inputs; rows with a null input or an evaluation error are null.
+// Only the ABI structs are declared, so no Arrow library is needed; build
+// with -DEXPRESSIONCALCULATOR_NO_MAIN to link this file into such a program
+// (and call simd_init(-1) once first).
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+typedef struct {
+    const void *buffers[2];        // validity, values; both owned
+} ArrowResult;
+
+static void arrow_release_result(struct ArrowArray *a) {
+    ArrowResult *r = a->private_data;
+    free((void *)r->buffers[0]);
+    free((void *)r->buffers[1]);
+    free(r);
+    a->release = NULL;
+}
+
+static void arrow_release_schema(struct ArrowSchema *s) { s->release = NULL; }
+
+// ORs the nulls of an Arrow validity bitmap (LSB first, starting at bit
+// offset) into missing.
+static void arrow_or_nulls(uint64_t *missing, const uint8_t *validity, size_t offset, size_t rows) {
+    if (!validity) return;
+    const uint8_t *v = validity + offset / 8;
+    if (offset % 8 == 0 && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+        for (size_t w = 0; w * 64 < rows; ++w) {
+            uint64_t bits = 0;
+            size_t bytes = (rows - w * 64 + 7) / 8;
+            memcpy(&bits, v + w * 8, bytes < 8 ? bytes : 8);
+            missing[w] |= ~bits;
+        }
+        return;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        size_t j = offset % 8 + i;
+        missing[i / 64] |= (uint64_t)(~v[j / 8] >> (j % 8) & 1) << (i % 64);
+    }
+}
+
+// Binds one child with logical rows [first, first + rows). ends receives an
+// owned array for run-end encoded children. 0 if the child does not fit,
+// -1 if out of memory.
+static int arrow_bind(const struct ArrowSchema *sc, const struct ArrowArray *ch, size_t first, size_t rows,
+                      uint64_t *missing, uint64_t *bad, EncodedColumn *out, uint64_t **ends) {
+    out->kind = ENC_PLAIN;
+    if (sc->dictionary) {
+        const struct ArrowArray *dict = ch->dictionary;
+        if (strcmp(sc->format, "i") != 0 || strcmp(sc->dictionary->format, "l") != 0 || !dict || ch->n_buffers != 2
+            || dict->n_buffers != 2 || dict->null_count != 0 || (size_t)ch->length < first + rows - (size_t)ch->offset)
+            return 0;
+        arrow_or_nulls(missing, ch->buffers[0], first, rows);
+        out->kind = ENC_DICT;
+        out->values = (const long long *)dict->buffers[1] + dict->offset;
+        out->n = (size_t)dict->length;
+        out->codes = (const uint32_t *)((const int32_t *)ch->buffers[1] + first);
+        uint32_t max_code = 0; // negative indices become huge and fail too
+        for (size_t i = 0; i < rows; ++i) max_code = out->codes[i] > max_code ? out->codes[i] : max_code;
+        return rows == 0 || max_code < out->n;
+    }
+    if (strcmp(sc->format, "+r") == 0) {
+        const struct ArrowArray *re = ch->n_children == 2 ? ch->children[0] : NULL, *va = re ? ch->children[1] : NULL;
+        int wide = re && strcmp(sc->children[0]->format, "l") == 0;
+        if (!re || (!wide && strcmp(sc->children[0]->format, "i") != 0) || strcmp(sc->children[1]->format, "l") != 0
+            || re->n_buffers != 2 || va->n_buffers != 2)
+            return 0;
+        // Run ends count logical rows of the whole array; rebase them on first.
+        size_t k = 0, nruns = (size_t)re->length, n = 0;
+        uint64_t end = 0;
+        while (k < nruns && (end = wide ? (uint64_t)((const int64_t *)re->buffers[1])[re->offset + k]
+                                        : (uint64_t)((const int32_t *)re->buffers[1])[re->offset + k]) <= first) k++;
+        if (!(*ends = malloc((nruns - k + 1) * sizeof(uint64_t)))) return -1;
+        out->kind = ENC_RLE;
+        out->values = (const long long *)va->buffers[1] + va->offset + k;
+        out->ends = *ends;
+        for (size_t start = 0; start < rows; start = (*ends)[n++], k++) {
+            if (k == nruns || (int64_t)(end = wide ? (uint64_t)((const int64_t *)re->buffers[1])[re->offset + k]
+                                                  : (uint64_t)((const int32_t *)re->buffers[1])[re->offset + k]) <= (int64_t)(first + start))
+                return 0;
+            (*ends)[n] = end - first < rows ? end - first : rows;
+            const uint8_t *vv = va->buffers[0];
+            size_t vi = (size_t)va->offset + k;
+            if (vv && !((vv[vi / 8] >> (vi % 8)) & 1)) // null run
+                for (size_t i = start; i < (*ends)[n]; ++i) missing[i / 64] |= 1ULL << (i % 64);
+        }
+        out->n = n;
+        return 1;
+    }
+    if ((strcmp(sc->format, "l") != 0 && strcmp(sc->format, "g") != 0) || ch->n_buffers != 2
+        || (size_t)ch->length < first + rows - (size_t)ch->offset)
+        return 0;
+    arrow_or_nulls(missing, ch->buffers[0], first, rows);
+    if (sc->format[0] == 'l') out->values = (const long long *)ch->buffers[1] + first;
+    else if (!(out->values = doubles_to_ll((const double *)ch->buffers[1] + first, rows, bad))) return -1;
+    return 1;
+}
+
+// Evaluates formula over the struct array described by schema/array and
+// exports the result into out_schema/out_array, which the caller releases.
+// The input is only borrowed. Returns 0 with err_msg set if the formula or
+// the input does not fit, or "Out of memory" with nothing left allocated;
+// it never exits.
+int arrow_evaluate(const char *formula, const struct ArrowSchema *schema, const struct ArrowArray *array,
+                   struct ArrowSchema *out_schema, struct ArrowArray *out_array, char *err_msg) {
+    TokenList *postfix = malloc(sizeof(TokenList));
+    Program *prog = malloc(sizeof(Program));
+    int ok = postfix && prog;
+    if (!ok) strcpy(err_msg, "Out of memory");
+    ok = ok && batch_compile(formula, postfix, prog, err_msg);
+    free(postfix);
+    if (ok && (strcmp(schema->format, "+s") != 0 || array->n_children != schema->n_children)) {
+        strcpy(err_msg, "Input must be a struct array");
+        ok = 0;
+    }
+
+    size_t rows = ok ? (size_t)array->length : 0, words = (rows + 63) / 64;
+    uint64_t *missing = calloc(words + 1, sizeof(uint64_t)), *bad = calloc(words + 1, sizeof(uint64_t));
+    EncodedColumn enc[MAX_VARS];
+    uint64_t *ends[MAX_VARS] = { 0 };
+    int converted[MAX_VARS] = { 0 }, bound;
+    if (ok && (!missing || !bad)) { strcpy(err_msg, "Out of memory"); ok = 0; }
+    if (ok) arrow_or_nulls(missing, array->n_buffers > 0 ? array->buffers[0] : NULL, (size_t)array->offset, rows);
+
+    for (int k = 0; ok && k < prog->nvars; ++k) {
+        int c = 0, len = prog->var_len[k] > 80 ? 80 : prog->var_len[k];
+        while (c < schema->n_children && !(strncmp(schema->children[c]->name, prog->var_name[k], (size_t)prog->var_len[k]) == 0
+                                           && schema->children[c]->name[prog->var_len[k]] == '\0')) c++;
+        if (c == schema->n_children) {
+            snprintf(err_msg, 128, "Column '%.*s' not found", len, prog->var_name[k]);
+            ok = 0;
+        } else if ((bound = arrow_bind(schema->children[c], array->children[c],
+                                       (size_t)array->offset + (size_t)array->children[c]->offset,
+                                       rows, missing, bad, &enc[k], &ends[k])) <= 0) {
+            if (bound < 0) strcpy(err_msg, "Out of memory");
+            else snprintf(err_msg, 128, "Column '%.*s' is not a supported int64 or float64 array", len, prog->var_name[k]);
+            ok = 0;
+        } else {
+            converted[k] = strcmp(schema->children[c]->format, "g") == 0;
+        }
+    }
+
+    if (ok) {
+        EncodedPlan plan;
+        ColumnBatch b;
+        long long *values = aligned_alloc(64, COLFILE_ALIGN(rows * 8 + 8)); // Arrow's recommended alignment
+        uint64_t *validity = aligned_alloc(64, COLFILE_ALIGN(words * 8 + 8));
+        ArrowResult *res = malloc(sizeof(ArrowResult));
+        int planned = values && validity && res && encoded_plan(&plan, enc, prog->nvars, rows);
+        int evaluated = planned && column_batch_try_alloc(&b, plan.n);
+        if (evaluated) {
+            b.cols = plan.cols;
+            if (plan.kind == ENC_PLAIN) { free(b.out); b.out = values; }
+            if (!(evaluated = columnar_try_evaluate(prog, &b))) {
+                if (plan.kind == ENC_PLAIN) b.out = NULL;
+                column_batch_free(&b);
+            }
+        }
+        if (!evaluated) {
+            if (planned) encoded_plan_free(&plan);
+            free(res);
+            free(validity);
+            free(values);
+            strcpy(err_msg, "Out of memory");
+            ok = 0;
+        } else {
+            int64_t nulls = (int64_t)encoded_expand(&plan, &b, rows, missing, bad, values, validity);
+
+            res->buffers[0] = validity;
+            res->buffers[1] = values;
+            *out_array = (struct ArrowArray){ (int64_t)rows, nulls, 0, 2, 0, res->buffers, NULL, NULL, arrow_release_result, res };
+            *out_schema = (struct ArrowSchema){ "l", "result", NULL, ARROW_FLAG_NULLABLE, 0, NULL, NULL, arrow_release_schema, NULL };
+            if (plan.kind == ENC_PLAIN) b.out = NULL;
+            column_batch_free(&b);
+            encoded_plan_free(&plan);
+        }
+    }
+
+    for (int k = 0; k < MAX_VARS; ++k) {
+        if (converted[k]) free((long long *)enc[k].values);
+        free(ends[k]);
+    }
+    free(bad);
+    free(missing);
+    free(prog);
+    return ok;
+}
+
+// -------------------- Main: interactive single-line evaluator --------------------
+#ifndef EXPRESSIONCALCULATOR_NO_MAIN
+enum { MODE_INT, MODE_BIG, MODE_RATIONAL, MODE_FIXED, MODE_DOUBLE, MODE_MOD };
+
+int main(int argc, char **argv) {
+    char *line = NULL;
+    size_t line_cap = 0;
+    int mode = MODE_INT;
+    int scale = 4, round_mode = ROUND_HALF_EVEN;
+    unsigned long long modulus = 0;
+    char *formula = NULL;
+    const char *table_path = NULL, *columns_path = NULL, *out_path = NULL, *where = NULL, *lines_path = NULL;
+    char table_delim = ',';
+    int bench = 0, aggregates = 0;
+    int simd = -1;
+    int cache_size = 1024, cache_stats = 0;
+    Arena arena; arena_init(&arena);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = ncpu > 0 ? (int)ncpu : 1;
+
+    for (int a = 1; a < argc; ++a) {
+        if (strcmp(argv[a], "--big") == 0) mode = MODE_BIG;
+        else if (strcmp(argv[a], "--rational") == 0) mode = MODE_RATIONAL;
+        else if (strcmp(argv[a], "--double") == 0) mode = MODE_DOUBLE;
+        else if (strcmp(argv[a], "--mod") == 0 && a + 1 < argc && strtoull(argv[a+1], NULL, 10) >= 2) {
+            mode = MODE_MOD;
+            modulus = strtoull(argv[++a], NULL, 10);
+        }
+        else if (strcmp(argv[a], "--fixed") == 0 && a + 1 < argc && atoi(argv[a+1]) >= 0 && atoi(argv[a+1]) <= FIXED_MAX_SCALE) {
+            mode = MODE_FIXED;
+            scale = atoi(argv[++a]);
+        }
+        else if (strcmp(argv[a], "--round") == 0 && a + 1 < argc) {
+            static const char *names[] = { "half-even", "half-up", "down", "floor", "ceiling" };
+            round_mode = -1;
+            for (int r = 0; r < 5; ++r) if (strcmp(argv[a+1], names[r]) == 0) round_mode = r;
+            if (round_mode < 0) { fprintf(stderr, "Unknown rounding mode: %s\n", argv[a+1]); return 1; }
+            a++;
+        }
+        else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) formula = argv[++a];
+        else if (strcmp(argv[a], "--where") == 0 && a + 1 < argc) where = argv[++a];
+        else if (strcmp(argv[a], "--aggregate") == 0 && a + 1 < argc) {
+            if (!(aggregates = aggregate_parse(argv[a+1]))) { fprintf(stderr, "Unknown aggregate in: %s\n", argv[a+1]); return 1; }
+            a++;
+        }
+        else if (strcmp(argv[a], "--bench") == 0) bench = 1;
+        else if ((strcmp(argv[a], "--csv") == 0 || strcmp(argv[a], "--tsv") == 0) && a + 1 < argc) {
+            table_delim = argv[a][2] == 'c' ? ',' : '\t';
+            table_path = argv[++a];
+        }
+        else if (strcmp(argv[a], "--columns") == 0 && a + 1 < argc) columns_path = argv[++a];
+        else if (strcmp(argv[a], "--lines") == 0 && a + 1 < argc) lines_path = argv[++a];
+        else if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) out_path = argv[++a];
+        else if (strcmp(argv[a], "--simd") == 0 && a + 1 < argc) {
+            simd = -2;
+            for (int l = 0; l < SIMD_LEVELS; ++l) if (strcmp(argv[a+1], simd_names[l]) == 0) simd = l;
+            if (simd == -2) { fprintf(stderr, "Unknown SIMD level: %s\n", argv[a+1]); return 1; }
+            a++;
+        }
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc && atoi(argv[a+1]) > 0) num_threads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--cache") == 0 && a + 1 < argc && atoi(argv[a+1]) >= 0) {
+            cache_size = atoi(argv[++a]);
+            cache_stats = 1;
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[a]);
+            fprintf(stderr, "Usage: %s [--big | --rational | --double | --fixed SCALE [--round MODE] | --mod N | --batch FORMULA [--where PREDICATE] [--aggregate LIST] [--csv FILE | --tsv FILE | --columns FILE [--out FILE] | --bench] | --lines FILE] [--threads N] [--simd LEVEL] [--cache N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!simd_init(simd)) { fprintf(stderr, "This CPU does not support %s\n", simd_names[simd]); return 1; }
+    if (aggregates && out_path) { fputs("--aggregate prints its results and cannot be combined with --out\n", stderr); return 1; }
+    if (lines_path) return run_lines(lines_path);
+    if (formula && columns_path) return run_columns(formula, where, aggregates, columns_path, out_path, bench);
+    if (formula && table_path) return run_delimited(formula, where, aggregates, table_path, table_delim);
+    if (formula) return run_batch(formula, where, aggregates, bench);
+
+    static const char *mode_names[] = { "integers", "arbitrary-precision integers", "exact rationals", "fixed-point decimals", "double precision", "integers modulo N" };
+    printf("Expression Calculator (%s)\n", mode_names[mode]);
+    fixed_init(scale, round_mode);
+    if (mode == MODE_MOD) mod_init(modulus);
+    ResultCache cache;
+    result_cache_init(&cache, cache_size);
+    printf("Supports: + - * / %% ^, < <= > >= == != && ||, parentheses, unary minus\n");
+    printf("Examples:\n");
+    printf("  -3 + 4*(2-1) ^ 3\n");
+    printf("  2*-5 + (7 - -(3))\n");
+    printf("Enter expression (or empty line to quit):\n\n");
+
+    while (1) {
+        printf("> ");
+        if (getline(&line, &line_cap, stdin) < 0) break;
+
+        // Trim leading spaces; quit on empty
+        int allspace = 1;
+        for (char *p=line; *p; ++p) { if (!isspace((unsigned char)*p)) { allspace = 0; break; } }
+        if (allspace) break;
+
+        TokenList postfix;
+        char err[128] = {0};
+
+        if (!infix_to_postfix(line, &postfix, err)) {
+            printf("Error (infix->postfix): %s\n", err);
+            continue;
+        }
+
+        printf("Postfix: ");
+        print_postfix(&postfix);
+
+        size_t key_len = 0;
+        char *key = cache.capacity ? canonical_key(&postfix, &key_len) : NULL;
+        uint64_t hash = key ? text_hash(key, key_len) : 0;
+        const char *cached = key ? result_cache_find(&cache, key, key_len, hash) : NULL;
+        if (cached) {
+            printf("Result: %s\n", cached);
+            free(key);
+            continue;
+        }
+
+        char buf[48];
+        const char *text = buf;
+        int ok;
+        if (mode == MODE_BIG) {
+            Num value;
+            arena_reset(&arena);
+            big_arena = &arena;
+            if ((ok = exact_evaluate_postfix(&postfix, &value, err))) text = num_to_dec(value);
+        } else if (mode == MODE_RATIONAL) {
+            Rat value;
+            arena_reset(&arena);
+            big_arena = &arena;
+            if ((ok = rational_evaluate_postfix(&postfix, &value, err))) text = rat_to_dec(value);
+        } else if (mode == MODE_MOD) {
+            ModVal value;
+            if ((ok = mod_evaluate_postfix(&postfix, &value, err))) sprintf(buf, "%llu", (unsigned long long)mod_out(value.r));
+        } else if (mode == MODE_DOUBLE) {
+            double value = 0;
+            if ((ok = double_evaluate_postfix(&postfix, &value, err))) double_to_shortest(value, buf);
+        } else if (mode == MODE_FIXED) {
+            long long value = 0;
+            if ((ok = fixed_evaluate_postfix(&postfix, &value, err))) fixed_to_dec(value, buf);
+        } else {
+            long long value = 0;
+            if ((ok = int64_evaluate_postfix(&postfix, &value, err))) sprintf(buf, "%lld", value);
+        }
+
+        if (!ok) {
+            printf("Error (evaluate): %s\n", err);
+        } else {
+            printf("Result: %s\n", text);
+            if (key) result_cache_insert(&cache, key, key_len, hash, text);
+        }
+        free(key);
+    }
+
+    if (cache_stats)
+        fprintf(stderr, "Cache: %zu hits, %zu misses, %zu evictions\n", cache.hits, cache.misses, cache.evictions);
+    result_cache_free(&cache);
+    arena_free(&arena);
+    free(line);
+    printf("Goodbye!\n");
+    return 0;
+}
+
+#endif // EXPRESSIONCALCULATOR_NO_MAIN
@@ -0,0 +1,486 @@
+// Header-only C++20 front end for expressioncalculator.c's integer mode.
+//
+// The same Shunting-Yard/postfix pipeline, written as constexpr functions so
+// constant formulas are evaluated by the compiler:
+//
+//     static_assert(exprcalc::evaluate("-3 + 4*(2-1) ^ 3") == 1);
+//
+// Formulas with variables compile into a callable whose code is specialized on
+// the postfix program; variables bind to the arguments in order of first
+// appearance and nothing is parsed at run time:
+//
+//     constexpr auto f = exprcalc::formula<"a*b + c^2">;
+//     long long r = f(2, 3, 4);   // 22
+//
+// Syntax errors are compile errors. Evaluation errors (division by zero,
+// exponent overflow) are compile errors in constant expressions and throw
+// std::domain_error at run time. +, - and * wrap like the C calculator.
+//
+// Column expressions and evaluate_columns() apply a formula to whole arrays
+// in one fused pass (see "Fused array evaluation" below).
+#ifndef EXPRESSIONCALCULATOR_HPP
+#define EXPRESSIONCALCULATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace exprcalc {
+
+inline constexpr int max_tokens = 256;
+inline constexpr int max_vars = 16;
+
+// -------------------- Tokens --------------------
+struct Token {
+    char op = 0;         // operator character ('u' = unary minus), or 0 for an operand
+    int var = -1;        // variable index, or -1 for a number
+    long long value = 0; // number value
+};
+
+struct Postfix {
+    std::array<Token, max_tokens> items{};
+    int count = 0;
+    int vars = 0;        // distinct variables
+    int depth = 0;       // deepest value stack the program needs
+};
+
+// -------------------- Operator utilities --------------------
+constexpr bool is_operator(char c) {
+    return c=='+' || c=='-' || c=='*' || c=='/' || c=='%' || c=='^' || c=='u'; // 'u' = unary minus
+}
+
+constexpr int precedence(char op) {
+    switch (op) {
+        case 'u': return 4; // unary minus: highest
+        case '^': return 3;
+        case '*': case '/': case '%': return 2;
+        case '+': case '-': return 1;
+        default: return 0;
+    }
+}
+
+constexpr bool is_right_assoc(char op) { return op == '^' || op == 'u'; }
+
+constexpr bool is_space(char c) { return c==' ' || c=='\t' || c=='\n' || c=='\r' || c=='\f' || c=='\v'; }
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_ident(char c) { return c=='_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c); }
+
+// -------------------- Infix to Postfix (Shunting-Yard) --------------------
+constexpr Postfix infix_to_postfix(std::string_view expr) {
+    Postfix out{};
+    std::array<char, max_tokens> ops{};
+    std::array<std::string_view, max_vars> names{};
+    int top = -1;
+    bool expect_operand = true; // start by expecting an operand (or unary minus or '(')
+
+    auto emit = [&](Token t) {
+        if (out.count >= max_tokens) throw std::invalid_argument("Too many tokens");
+        out.items[out.count++] = t;
+    };
+    auto push_op = [&](char op) {
+        if (top + 1 >= max_tokens) throw std::invalid_argument("Operator stack overflow");
+        ops[++top] = op;
+    };
+
+    std::size_t i = 0;
+    while (i < expr.size()) {
+        char c = expr[i];
+        if (is_space(c)) { i++; continue; }
+
+        // Number
+        if (is_digit(c)) {
+            long long v = 0;
+            for (; i < expr.size() && is_digit(expr[i]); ++i) {
+                int d = expr[i] - '0';
+                if (v > (LLONG_MAX - d) / 10) throw std::invalid_argument("Invalid number in postfix");
+                v = v * 10 + d;
+            }
+            if (i < expr.size() && expr[i] == '.') throw std::invalid_argument("Decimal literals are not supported");
+            Token t; t.value = v;
+            emit(t);
+            expect_operand = false;
+            continue;
+        }
+
+        // Variable
+        if (is_ident(c)) {
+            std::size_t start = i;
+            while (i < expr.size() && is_ident(expr[i])) i++;
+            std::string_view name = expr.substr(start, i - start);
+            int idx = 0;
+            while (idx < out.vars && names[idx] != name) idx++;
+            if (idx == out.vars) {
+                if (out.vars >= max_vars) throw std::invalid_argument("Too many variables");
+                names[out.vars++] = name;
+            }
+            Token t; t.var = idx;
+            emit(t);
+            expect_operand = false;
+            continue;
+        }
+
+        // Parentheses
+        if (c == '(') { push_op('('); i++; expect_operand = true; continue; }
+        if (c == ')') {
+            bool matched = false;
+            while (top >= 0) {
+                char op = ops[top--];
+                if (op == '(') { matched = true; break; }
+                Token t; t.op = op;
+                emit(t);
+            }
+            if (!matched) throw std::invalid_argument("Mismatched parentheses");
+            i++; expect_operand = false;
+            continue;
+        }
+
+        // Operators (including unary minus)
+        if (is_operator(c) && c != 'u') {
+            char op = c;
+            if (op == '-' && expect_operand) op = 'u';
+            else if (expect_operand) throw std::invalid_argument("Unexpected operator");
+
+            // Pop while higher precedence (or equal & left-assoc)
+            while (top >= 0 && is_operator(ops[top])) {
+                int ptop = precedence(ops[top]), popr = precedence(op);
+                if (ptop > popr || (ptop == popr && !is_right_assoc(op))) {
+                    Token t; t.op = ops[top--];
+                    emit(t);
+                } else break;
+            }
+            push_op(op);
+            i++;
+            expect_operand = (op != 'u'); // same rule as the C lexer, so "--3" is rejected the same way
+            continue;
+        }
+
+        throw std::invalid_argument("Invalid character");
+    }
+
+    // Drain operator stack
+    while (top >= 0) {
+        char op = ops[top--];
+        if (op == '(') throw std::invalid_argument("Mismatched parentheses");
+        Token t; t.op = op;
+        emit(t);
+    }
+    if (expect_operand) throw std::invalid_argument("Expression ends unexpectedly");
+
+    // Size the value stack, which also rejects programs the evaluator could not run
+    int depth = 0;
+    for (int k = 0; k < out.count; ++k) {
+        const Token &t = out.items[k];
+        if (!t.op) { if (++depth > out.depth) out.depth = depth; }
+        else if (t.op == 'u') { if (depth < 1) throw std::invalid_argument("Not enough operands for unary minus"); }
+        else if (depth-- < 2) throw std::invalid_argument("Not enough operands for binary operator");
+    }
+    if (depth != 1) throw std::invalid_argument("Extra operands or insufficient operators");
+    return out;
+}
+
+// -------------------- Operators --------------------
+constexpr long long wrap(unsigned long long v) { return static_cast<long long>(v); }
+
+constexpr long long checked_pow(long long base, long long exp) {
+    if (exp < 0) throw std::domain_error("Invalid or overflow in exponentiation");
+    bool neg = base < 0 && (exp & 1);
+    unsigned long long mag = base < 0 ? 0ULL - static_cast<unsigned long long>(base) : static_cast<unsigned long long>(base);
+    unsigned long long limit = neg ? 1ULL << 63 : static_cast<unsigned long long>(LLONG_MAX);
+    unsigned long long acc = 1;
+    if (mag <= 1) acc = exp ? mag : 1;
+    else {
+        // square-and-multiply; mag >= 2 overflows within 64 squarings
+        for (unsigned long long e = static_cast<unsigned long long>(exp); e; e >>= 1) {
+            if ((e & 1) && (__builtin_mul_overflow(acc, mag, &acc) || acc > limit))
+                throw std::domain_error("Invalid or overflow in exponentiation");
+            if (e > 1 && __builtin_mul_overflow(mag, mag, &mag))
+                throw std::domain_error("Invalid or overflow in exponentiation");
+        }
+    }
+    return neg ? wrap(0ULL - acc) : static_cast<long long>(acc);
+}
+
+constexpr long long negate(long long a) { return wrap(0ULL - static_cast<unsigned long long>(a)); }
+
+constexpr long long apply_op(char op, long long a, long long b) {
+    unsigned long long ua = static_cast<unsigned long long>(a), ub = static_cast<unsigned long long>(b);
+    switch (op) {
+        case '+': return wrap(ua + ub);
+        case '-': return wrap(ua - ub);
+        case '*': return wrap(ua * ub);
+        case '/':
+            if (b == 0) throw std::domain_error("Division by zero");
+            if (a == LLONG_MIN && b == -1) throw std::domain_error("Division overflow");
+            return a / b;
+        case '%':
+            if (b == 0) throw std::domain_error("Modulo by zero");
+            return b == -1 ? 0 : a % b;
+        case '^': return checked_pow(a, b);
+        default: throw std::domain_error("Unknown operator in evaluation");
+    }
+}
+
+// -------------------- Postfix evaluation --------------------
+// Interprets a program; vars holds one value per variable.
+constexpr long long evaluate_postfix(const Postfix &p, const long long *vars) {
+    std::array<long long, max_tokens> stk{};
+    int sp = -1;
+    for (int k = 0; k < p.count; ++k) {
+        const Token &t = p.items[k];
+        if (!t.op) stk[++sp] = t.var >= 0 ? vars[t.var] : t.value;
+        else if (t.op == 'u') stk[sp] = negate(stk[sp]);
+        else { long long b = stk[sp--]; stk[sp] = apply_op(t.op, stk[sp], b); }
+    }
+    return stk[0];
+}
+
+// Value of a constant expression; usable in constant expressions.
+constexpr long long evaluate(std::string_view expr) {
+    Postfix p = infix_to_postfix(expr);
+    if (p.vars) throw std::invalid_argument("Unbound variable");
+    return evaluate_postfix(p, nullptr);
+}
+
+// -------------------- Compiled formulas --------------------
+template <std::size_t N>
+struct fixed_string {
+    char data[N]{};
+    constexpr fixed_string(const char (&s)[N]) { for (std::size_t i = 0; i < N; ++i) data[i] = s[i]; }
+    constexpr std::string_view view() const { return std::string_view(data, N - 1); }
+};
+
+// One instantiation of step() per token, so each instruction is straight-line
+// code with its operator and literal operand known to the optimizer.
+template <Postfix P>
+struct Formula {
+    static constexpr int arity = P.vars;
+
+    template <class... Args>
+    constexpr long long operator()(Args... args) const {
+        static_assert(sizeof...(Args) == arity, "formula called with the wrong number of variables");
+        const long long vars[arity > 0 ? arity : 1] = { static_cast<long long>(args)... };
+        long long stk[P.depth] = {};
+        int sp = -1;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (step<P.items[I]>(stk, sp, vars), ...);
+        }(std::make_index_sequence<P.count>{});
+        return stk[0];
+    }
+
+private:
+    template <Token T>
+    static constexpr void step(long long *stk, int &sp, const long long *vars) {
+        if constexpr (T.op == 0 && T.var >= 0) stk[++sp] = vars[T.var];
+        else if constexpr (T.op == 0) stk[++sp] = T.value;
+        else if constexpr (T.op == 'u') stk[sp] = negate(stk[sp]);
+        else { long long b = stk[sp--]; stk[sp] = apply_op(T.op, stk[sp], b); }
+    }
+};
+
+template <Postfix P>
+consteval Postfix checked() { return P; }
+
+template <fixed_string F>
+inline constexpr Formula<checked<infix_to_postfix(F.view())>()> formula{};
+
+// -------------------- Fused array evaluation --------------------
+// Column expressions build a type mirroring the formula, and assign() runs
+// it as one loop over the rows with no temporary arrays:
+//
+//     exprcalc::assign(r, col(a) * col(b) + exprcalc::pow(col(c), 2));
+//
+// C++'s ^ binds looser than +, so the calculator's '^' is spelled pow().
+// Element errors set bits instead of throwing, keeping the loop branch-free;
+// assign() throws std::domain_error after the loop if any row failed.
+enum : unsigned { err_div_zero = 1, err_div_overflow = 2, err_mod_zero = 4, err_pow = 8 };
+
+constexpr long long pow_flagged(long long base, long long exp, unsigned &err) {
+    if (exp < 0) { err |= err_pow; return 0; }
+    bool neg = base < 0 && (exp & 1);
+    unsigned long long mag = base < 0 ? 0ULL - static_cast<unsigned long long>(base) : static_cast<unsigned long long>(base);
+    unsigned long long limit = neg ? 1ULL << 63 : static_cast<unsigned long long>(LLONG_MAX);
+    unsigned long long acc = mag <= 1 && exp ? mag : 1;
+    bool ovf = false;
+    for (unsigned long long e = mag > 1 ? static_cast<unsigned long long>(exp) : 0; e && !ovf; e >>= 1) {
+        if (e & 1) ovf |= __builtin_mul_overflow(acc, mag, &acc) || acc > limit;
+        if (e > 1) ovf |= __builtin_mul_overflow(mag, mag, &mag);
+    }
+    if (ovf) { err |= err_pow; return 0; }
+    return neg ? wrap(0ULL - acc) : static_cast<long long>(acc);
+}
+
+// Element kernels shared by expression templates and runtime formulas.
+template <char Op>
+constexpr long long apply_flagged(long long a, long long b, unsigned &err) {
+    unsigned long long ua = static_cast<unsigned long long>(a), ub = static_cast<unsigned long long>(b);
+    if constexpr (Op == '+') return wrap(ua + ub);
+    else if constexpr (Op == '-') return wrap(ua - ub);
+    else if constexpr (Op == '*') return wrap(ua * ub);
+    else if constexpr (Op == '/') {
+        bool zero = b == 0, ovf = a == LLONG_MIN && b == -1;
+        err |= (zero ? err_div_zero : 0u) | (ovf ? err_div_overflow : 0u);
+        return a / (zero || ovf ? 1 : b);
+    }
+    else if constexpr (Op == '%') {
+        err |= b == 0 ? err_mod_zero : 0u;
+        return a % (b == 0 || b == -1 ? 1 : b);
+    }
+    else if constexpr (Op == '^') return pow_flagged(a, b, err);
+    else static_assert(Op == '+', "unknown operator");
+}
+
+inline void throw_element_errors(unsigned err) {
+    if (err & err_div_zero) throw std::domain_error("Division by zero");
+    if (err & err_div_overflow) throw std::domain_error("Division overflow");
+    if (err & err_mod_zero) throw std::domain_error("Modulo by zero");
+    if (err & err_pow) throw std::domain_error("Invalid or overflow in exponentiation");
+}
+
+inline constexpr std::size_t broadcast = static_cast<std::size_t>(-1); // size() of a scalar
+
+template <class E> struct Expr {}; // base of every column expression
+
+struct Column : Expr<Column> {
+    const long long *data;
+    std::size_t n;
+    long long at(std::size_t i, unsigned &) const { return data[i]; }
+    std::size_t size() const { return n; }
+};
+
+struct Scalar : Expr<Scalar> {
+    long long v;
+    long long at(std::size_t, unsigned &) const { return v; }
+    std::size_t size() const { return broadcast; }
+};
+
+template <char Op, class L, class R>
+struct Binary : Expr<Binary<Op, L, R>> {
+    L l;
+    R r;
+    std::size_t n;
+    Binary(L l_, R r_) : l(l_), r(r_), n(l_.size() == broadcast ? r_.size() : l_.size()) {
+        if (l_.size() != broadcast && r_.size() != broadcast && l_.size() != r_.size())
+            throw std::invalid_argument("Column lengths differ");
+    }
+    long long at(std::size_t i, unsigned &err) const { return apply_flagged<Op>(l.at(i, err), r.at(i, err), err); }
+    std::size_t size() const { return n; }
+};
+
+template <class E>
+struct Negate : Expr<Negate<E>> {
+    E e;
+    long long at(std::size_t i, unsigned &err) const { return negate(e.at(i, err)); }
+    std::size_t size() const { return e.size(); }
+};
+
+inline Column col(std::span<const long long> v) { return Column{ {}, v.data(), v.size() }; }
+
+template <class T>
+concept ColumnExpr = std::is_base_of_v<Expr<T>, T>;
+
+template <class T>
+concept Operand = ColumnExpr<T> || std::is_integral_v<T>;
+
+template <Operand T>
+auto as_expr(const T &v) {
+    if constexpr (ColumnExpr<T>) return v;
+    else return Scalar{ {}, static_cast<long long>(v) };
+}
+
+template <char Op, Operand L, Operand R>
+    requires (ColumnExpr<L> || ColumnExpr<R>)
+auto make_binary(const L &l, const R &r) {
+    using LE = decltype(as_expr(l));
+    using RE = decltype(as_expr(r));
+    return Binary<Op, LE, RE>(as_expr(l), as_expr(r));
+}
+
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto operator+(const L &l, const R &r) { return make_binary<'+'>(l, r); }
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto operator-(const L &l, const R &r) { return make_binary<'-'>(l, r); }
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto operator*(const L &l, const R &r) { return make_binary<'*'>(l, r); }
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto operator/(const L &l, const R &r) { return make_binary<'/'>(l, r); }
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto operator%(const L &l, const R &r) { return make_binary<'%'>(l, r); }
+template <Operand L, Operand R> requires (ColumnExpr<L> || ColumnExpr<R>)
+auto pow(const L &l, const R &r) { return make_binary<'^'>(l, r); }
+
+template <ColumnExpr E>
+auto operator-(const E &e) { return Negate<E>{ {}, e }; }
+
+// out[i] = expr(i) for every row, in one pass.
+template <ColumnExpr E>
+void assign(std::span<long long> out, const E &expr) {
+    if (expr.size() != broadcast && expr.size() != out.size()) throw std::invalid_argument("Column lengths differ");
+    unsigned err = 0;
+    for (std::size_t i = 0; i < out.size(); ++i) out[i] = expr.at(i, err);
+    if (err) throw_element_errors(err);
+}
+
+// -------------------- Runtime formulas over columns --------------------
+// A formula parsed at run time is run over blocks of rows: each postfix token
+// becomes one tight loop over the block using the element kernels above, so
+// only a block-sized register per stack slot is ever materialized.
+// vars[k] is the column for the k-th variable in order of first appearance.
+inline constexpr std::size_t column_block = 256;
+
+template <char Op>
+void kernel(long long *a, const long long *b, std::size_t n, unsigned &err) {
+    for (std::size_t i = 0; i < n; ++i) a[i] = apply_flagged<Op>(a[i], b[i], err);
+}
+
+inline void evaluate_columns(const Postfix &p, std::span<const std::span<const long long>> vars,
+                             std::span<long long> out) {
+    if (static_cast<int>(vars.size()) != p.vars) throw std::invalid_argument("Wrong number of variable columns");
+    for (const auto &v : vars)
+        if (v.size() != out.size()) throw std::invalid_argument("Column lengths differ");
+
+    std::vector<long long> regs(static_cast<std::size_t>(p.depth) * column_block);
+    unsigned err = 0;
+    for (std::size_t base = 0; base < out.size(); base += column_block) {
+        std::size_t n = std::min(column_block, out.size() - base);
+        std::size_t depth = 0; // registers in use; the top one is the last
+        for (int k = 0; k < p.count; ++k) {
+            const Token &t = p.items[k];
+            if (!t.op) {
+                long long *top = regs.data() + depth++ * column_block;
+                if (t.var >= 0) std::copy_n(vars[t.var].data() + base, n, top);
+                else std::fill_n(top, n, t.value);
+                continue;
+            }
+            long long *top = regs.data() + (depth - 1) * column_block;
+            if (t.op == 'u') { for (std::size_t i = 0; i < n; ++i) top[i] = negate(top[i]); continue; }
+            long long *a = regs.data() + (--depth - 1) * column_block;
+            switch (t.op) {
+                case '+': kernel<'+'>(a, top, n, err); break;
+                case '-': kernel<'-'>(a, top, n, err); break;
+                case '*': kernel<'*'>(a, top, n, err); break;
+                case '/': kernel<'/'>(a, top, n, err); break;
+                case '%': kernel<'%'>(a, top, n, err); break;
+                case '^': kernel<'^'>(a, top, n, err); break;
+            }
+        }
+        std::copy_n(regs.data(), n, out.data() + base);
+    }
+    if (err) throw_element_errors(err);
+}
+
+inline void evaluate_columns(std::string_view formula, std::span<const std::span<const long long>> vars,
+                             std::span<long long> out) {
+    Postfix p = infix_to_postfix(formula);
+    evaluate_columns(p, vars, out);
+}
+
+} // namespace exprcalc
+
+#endif // EXPRESSIONCALCULATOR_HPP